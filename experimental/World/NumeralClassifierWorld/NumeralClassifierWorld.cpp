@@ -15,6 +15,7 @@ shared_ptr<ParameterLink<int>> NumeralClassifierWorld::defaulttestsPreWorldEvalP
 shared_ptr<ParameterLink<int>> NumeralClassifierWorld::defaultWorldUpdatesPL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER-WorldUpdates", 100, "number of world updates brain has to evaluate each value");
 shared_ptr<ParameterLink<int>> NumeralClassifierWorld::defaultRetinaTypePL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER-retinaType", 3, "1 = center only, 2 = 3 across, 3 = 3x3, 4 = 5x5, 5 = 7x7");
 shared_ptr<ParameterLink<string>> NumeralClassifierWorld::numeralDataFileNamePL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER-dataFileName", (string) "World/NumeralClassifierWorld/mnist.train.discrete.28x28-only100", "name of file with numeral data");
+shared_ptr<ParameterLink<int>> NumeralClassifierWorld::evaluationThreadsPL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER-evaluationThreads", 1, "number of threads used to evaluate the population (brains must be safe to update concurrently, e.g. TPG without the random op)");
 
 shared_ptr<ParameterLink<string>> NumeralClassifierWorld::groupNamePL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER_NAMES-groupNameSpace", (string)"root::", "namespace of group to be evaluated");
 shared_ptr<ParameterLink<string>> NumeralClassifierWorld::brainNamePL = Parameters::register_parameter("WORLD_NUMERALCLASSIFIER_NAMES-brainNameSpace", (string)"root::", "namespace for parameters used to define brain");
@@ -25,6 +26,7 @@ NumeralClassifierWorld::NumeralClassifierWorld(shared_ptr<ParametersTable> _PT)
 	testsPreWorldEval = defaulttestsPreWorldEvalPL->get(PT);
 	retinaType = defaultRetinaTypePL->get(PT);  //1 = center only, 2 = 3 across, 3 = 3x3, 4 = 5x5, 5 = 7x7
 	numeralDataFileName = numeralDataFileNamePL->get(PT);
+	evaluationThreads = evaluationThreadsPL->get(PT);
 
 	string groupName = groupNamePL->get(PT);
 	brainName = brainNamePL->get(PT);
@@ -123,7 +125,7 @@ NumeralClassifierWorld::NumeralClassifierWorld(shared_ptr<ParametersTable> _PT)
 }
 
 
-void NumeralClassifierWorld::evaluateSolo(shared_ptr<Organism> org, int analyse, int visualize, int debug){
+void NumeralClassifierWorld::evaluateSolo(shared_ptr<Organism> org, int analyse, int visualize, int debug, mt19937 &generator){
 //void NumeralClassifierWorld::runWorldSolo(shared_ptr<Organism> org, bool analyse, bool visualize, bool debug) {
 	// numeralClassifierWorld assumes there will only ever be one agent being tested at a time. It uses org by default.
 	
@@ -152,7 +154,7 @@ void NumeralClassifierWorld::evaluateSolo(shared_ptr<Organism> org, int analyse,
 		bool goodNumber = false;
 		while (!goodNumber) {
 			goodNumber = true;
-			numeralPick = Random::getIndex(10);  // pick a number
+			numeralPick = Random::getIndex(10, generator);  // pick a number
 			for (int check = 0; check < 10; check++) {
 				if (counts[check] < counts[numeralPick]) {
 					goodNumber = false;
@@ -160,9 +162,9 @@ void NumeralClassifierWorld::evaluateSolo(shared_ptr<Organism> org, int analyse,
 			}
 		}
 		counts[numeralPick]++;
-		whichNumeral = Random::getIndex(numeralData[numeralPick].size() / (28 * 28));
-		currentX = Random::getIndex(28);  // place organism somewhere in the world
-		currentY = Random::getIndex(28);  // place organism somewhere in the world
+		whichNumeral = Random::getIndex(numeralData[numeralPick].size() / (28 * 28), generator);
+		currentX = Random::getIndex(28, generator);  // place organism somewhere in the world
+		currentY = Random::getIndex(28, generator);  // place organism somewhere in the world
 
 		for (int worldUpdate = 0; worldUpdate < worldUpdates; worldUpdate++) {
 
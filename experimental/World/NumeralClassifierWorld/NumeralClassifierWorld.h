@@ -12,8 +12,11 @@
 
 #include <iostream>
 #include <fstream>
+#include <limits>
+#include <random>
 #include <stdio.h>
 #include <stdlib.h>
+#include <thread>
 
 #include "../AbstractWorld.h"
 
@@ -33,6 +36,7 @@ public:
 	static shared_ptr<ParameterLink<int>> defaultWorldUpdatesPL;
 	static shared_ptr<ParameterLink<int>> defaultRetinaTypePL;
 	static shared_ptr<ParameterLink<string>> numeralDataFileNamePL;
+	static shared_ptr<ParameterLink<int>> evaluationThreadsPL;
 
 	// end parameters
 
@@ -40,6 +44,7 @@ public:
 	int testsPreWorldEval;
 	int retinaType;
 	string numeralDataFileName;
+	int evaluationThreads;
 
 	static shared_ptr<ParameterLink<string>> groupNamePL;
 	static shared_ptr<ParameterLink<string>> brainNamePL;
@@ -63,13 +68,38 @@ public:
 	NumeralClassifierWorld(shared_ptr<ParametersTable> _PT = nullptr);
 
 	virtual void evaluate(map<string, shared_ptr<Group>>& groups, int analyse, int visualize, int debug) {
-		int popSize = groups[groupNamePL->get(PT)]->population.size();
-		for (int i = 0; i < popSize; i++) {
-			evaluateSolo(groups[groupNamePL->get(PT)]->population[i], analyse, visualize, debug);
+		auto &population = groups[groupNamePL->get(PT)]->population;
+		int popSize = population.size();
+		if (evaluationThreads > 1 && !visualize && !debug) {
+			// each thread evaluates every evaluationThreads-th org with it's own random generator.
+			// brains must be safe to update at the same time (i.e. TPG brains without the random op)
+			vector<thread> threads;
+			vector<mt19937> generators;
+			for (int t = 0; t < evaluationThreads; t++) { // seeds are drawn in order so runs are repeatable for a given thread count
+				generators.push_back(mt19937((unsigned int)Random::getIndex(numeric_limits<int>::max())));
+			}
+			for (int t = 0; t < evaluationThreads; t++) {
+				threads.push_back(thread([&, t]() {
+					for (int i = t; i < popSize; i += evaluationThreads) {
+						evaluateSolo(population[i], analyse, visualize, debug, generators[t]);
+					}
+				}));
+			}
+			for (auto & t : threads) {
+				t.join();
+			}
+		}
+		else {
+			for (int i = 0; i < popSize; i++) {
+				evaluateSolo(population[i], analyse, visualize, debug);
+			}
 		}
 	}
 
-	virtual void evaluateSolo(shared_ptr<Organism> org, int analyse, int visualize, int debug);
+	virtual void evaluateSolo(shared_ptr<Organism> org, int analyse, int visualize, int debug) {
+		evaluateSolo(org, analyse, visualize, debug, Random::getCommonGenerator());
+	}
+	void evaluateSolo(shared_ptr<Organism> org, int analyse, int visualize, int debug, mt19937 &generator);
 
 	virtual unordered_map<string, unordered_set<string>> requiredGroups() override {
 		return { { groupNamePL->get(PT),{ "B:" + brainNamePL->get(PT) + "," + to_string(inputNodesCount) + "," + to_string(outputNodesCount) } } }; // default requires a root group and a brain (in root namespace) and no genome 
@@ -0,0 +1,177 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include "TPGBrain.h"
+
+#include <chrono>
+#include <cmath>
+#include <ostream>
+#include <random>
+#include <string>
+#include <vector>
+
+// microbenchmark of the TPG program interpreters on random programs made with the settings of
+// a graph. if MABE is built with -DTPG_BENCHMARK the progenitor brain runs it and prints the
+// time per instruction of each interpreter:
+//   reference - Program::evaluateReference (decodes instructionCodes on every call)
+//   switch - Program::evaluateSwitch (compiled code, a switch per instruction)
+//   threaded - Program::evaluate (threaded code)
+// programs are made twice, with all ops and without SINCOS (the threaded fast path when the
+// random op is off). times are given per instruction of the program (numInstruction) and per
+// instruction left after compiling (effective). programs and inputs come from a fixed seed so
+// runs can be compared.
+// selfTest checks the compiled interpreters against the reference on random programs and
+// inputs without timing them (see BRAIN_TPG-selfTest).
+class TPGBenchmark {
+public:
+	static void run(const TPGBrain::Graph &graph, std::ostream &out, int programCount = 1000, int inputSets = 16, double minSeconds = 0.25) {
+		std::mt19937 generator(2019);
+		std::vector<double> inputs, hidden;
+		makeInputs(graph, inputSets, generator, inputs, hidden);
+		out << "  TPG interpreter benchmark (" << programCount << " programs of " << graph.numInstructions << " instructions, " <<
+			inputSets << " input sets, ns per instruction / per effective instruction):\n";
+		for (bool withSinCos : { true, false }) {
+			auto programs = makePrograms(graph, programCount, withSinCos, generator);
+			long long effective = 0;
+			for (auto const & p : programs) {
+				effective += p.effectiveLength();
+			}
+			int mismatches = countMismatches(graph, programs, inputs, hidden, inputSets);
+			std::vector<std::vector<double>> inputVectors, hiddenVectors; // evaluateReference takes vectors
+			for (int set = 0; set < inputSets; set++) {
+				inputVectors.emplace_back(inputs.begin() + set * graph.inputCount, inputs.begin() + (set + 1) * graph.inputCount);
+				hiddenVectors.emplace_back(hidden.begin() + set * graph.hiddenCount, hidden.begin() + (set + 1) * graph.hiddenCount);
+			}
+			double reference = timePass(minSeconds, [&](double &sum) {
+				for (int set = 0; set < inputSets; set++) {
+					for (auto const & p : programs) {
+						sum += p.evaluateReference(inputVectors[set], hiddenVectors[set], graph.numOps);
+					}
+				}
+			});
+			double switched = timePass(minSeconds, [&](double &sum) {
+				for (int set = 0; set < inputSets; set++) {
+					for (auto const & p : programs) {
+						sum += p.evaluateSwitch(&inputs[set * graph.inputCount], &hidden[set * graph.hiddenCount]);
+					}
+				}
+			});
+			double threaded = timePass(minSeconds, [&](double &sum) {
+				for (int set = 0; set < inputSets; set++) {
+					for (auto const & p : programs) {
+						sum += p.evaluate(&inputs[set * graph.inputCount], &hidden[set * graph.hiddenCount]);
+					}
+				}
+			});
+			double instructions = (double)programCount * graph.numInstructions * inputSets;
+			double effectiveInstructions = std::max(1.0, (double)effective * inputSets);
+			out << "    " << (withSinCos ? "all ops     " : "no sin/cos  ") <<
+				"reference: " << reference / instructions << " / " << reference / effectiveInstructions <<
+				"  switch: " << switched / instructions << " / " << switched / effectiveInstructions <<
+				"  threaded: " << threaded / instructions << " / " << threaded / effectiveInstructions <<
+				"  (" << (double)effective / programCount << " effective instructions per program";
+			if (mismatches > 0) {
+				out << ", " << mismatches << " results differ from the reference";
+			}
+			out << ")\n";
+		}
+		out << std::flush;
+	}
+
+	// run random programs with and without SINCOS on random inputs and compare
+	// evaluateThreaded (both versions) and evaluateSwitch against evaluateReference.
+	// returns the number of program/input pairs where any result differs.
+	static int selfTest(const TPGBrain::Graph &graph, std::ostream &out, int programCount = 1000, int inputSets = 16) {
+		std::mt19937 generator(2019);
+		std::vector<double> inputs, hidden;
+		makeInputs(graph, inputSets, generator, inputs, hidden);
+		int mismatches = 0;
+		for (bool withSinCos : { true, false }) {
+			mismatches += countMismatches(graph, makePrograms(graph, programCount, withSinCos, generator), inputs, hidden, inputSets);
+		}
+		out << "  TPG interpreter self test (" << 2 * programCount << " programs, " << inputSets << " input sets): " <<
+			(mismatches == 0 ? std::string("all results match the reference") : std::to_string(mismatches) + " results differ from the reference") << std::endl;
+		return mismatches;
+	}
+
+private:
+	static void makeInputs(const TPGBrain::Graph &graph, int inputSets, std::mt19937 &generator, std::vector<double> &inputs, std::vector<double> &hidden) {
+		inputs.resize(inputSets * graph.inputCount);
+		hidden.resize(inputSets * graph.hiddenCount);
+		for (auto & value : inputs) {
+			value = Random::getDouble(-1.0, 1.0, generator);
+		}
+		for (auto & value : hidden) {
+			value = Random::getIndex(2, generator);
+		}
+	}
+
+	// programs that use the random op are skipped, their results can not be repeated.
+	// evaluateThreaded<false> is only checked on programs without SINCOS (it skips SINCOS).
+	static int countMismatches(const TPGBrain::Graph &graph, const std::vector<TPGBrain::Program> &programs,
+		const std::vector<double> &inputs, const std::vector<double> &hidden, int inputSets) {
+		int mismatches = 0;
+		for (auto const & p : programs) {
+			for (int set = 0; set < inputSets && !p.usesRandomOp; set++) {
+				std::vector<double> in(inputs.begin() + set * graph.inputCount, inputs.begin() + (set + 1) * graph.inputCount);
+				std::vector<double> hid(hidden.begin() + set * graph.hiddenCount, hidden.begin() + (set + 1) * graph.hiddenCount);
+				double expected = p.evaluateReference(in, hid, graph.numOps);
+				if (!same(p.evaluateThreaded<true>(in.data(), hid.data()), expected) ||
+					(!p.usesSinCos && !same(p.evaluateThreaded<false>(in.data(), hid.data()), expected)) ||
+					!same(p.evaluateSwitch(in.data(), hid.data()), expected)) {
+					mismatches++;
+				}
+			}
+		}
+		return mismatches;
+	}
+
+	static std::vector<TPGBrain::Program> makePrograms(const TPGBrain::Graph &graph, int programCount, bool withSinCos, std::mt19937 &generator) {
+		std::vector<TPGBrain::Program> programs(programCount);
+		for (auto & p : programs) {
+			for (int i = 0; i < graph.numInstructions * 4; i++) {
+				int code = Random::getIndex(256, generator);
+				if (!withSinCos && i % 4 == 0 && code % graph.numOps == TPGBrain::Program::SINCOS) {
+					code++; // next op
+				}
+				p.instructionCodes.push_back(code);
+			}
+			for (int i = 0; i < graph.registersSize; i++) {
+				p.registerPresets.push_back(Random::getDouble(1.0, generator));
+			}
+			p.compile(graph.inputCount, graph.hiddenCount, graph.numOps);
+		}
+		return programs;
+	}
+
+	static bool same(double a, double b) {
+		return a == b || (std::isnan(a) && std::isnan(b));
+	}
+
+	// ns per call of pass, pass is called until minSeconds have gone by
+	template <class Pass>
+	static double timePass(double minSeconds, Pass pass) {
+		double sum = 0;
+		pass(sum); // warm up
+		long long passes = 0;
+		auto start = std::chrono::steady_clock::now();
+		std::chrono::duration<double> elapsed(0);
+		while (elapsed.count() < minSeconds) {
+			pass(sum);
+			passes++;
+			elapsed = std::chrono::steady_clock::now() - start;
+		}
+		volatile double sink = sum; // keep the results live
+		(void)sink;
+		return elapsed.count() * 1e9 / passes;
+	}
+};
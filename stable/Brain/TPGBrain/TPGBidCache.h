@@ -0,0 +1,169 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+// cache of program bids keyed by program ID and a hash of the input and hidden
+// values the program was run on. Programs are shared by many Nodes (and so many
+// brains), when a world shows the same inputs to many organisms the same program
+// would otherwise be run again and again on the same values.
+// the state is identified by two independent 64 bit hashes: hash picks the entry and
+// fingerprint is stored in it and compared on every hit, so a hit for other values needs
+// both hashes to collide. program IDs are compared exactly (they are the outer key).
+// entries for a program must be dropped (invalidate()) if the program is changed
+// or deleted.
+// the cache is split into shardCount shards by program ID, each with its own mutex, map
+// and counters, so threads looking up different programs do not wait on each other.
+// each shard holds up to maxEntries / shardCount bids and is cleared when it is full.
+// lookup, store, invalidate and clear are safe to call from several threads.
+class TPGBidCache {
+public:
+	static const int shardCount = 16;
+
+	struct State {
+		uint64_t hash;
+		uint64_t fingerprint;
+	};
+
+	struct Entry {
+		uint64_t fingerprint;
+		double bid;
+	};
+
+	struct alignas(64) Shard { // own cache line, so shards used by different threads do not share one
+		std::unordered_map<long, std::unordered_map<uint64_t, Entry>> bids; // programID -> state hash -> bid
+		std::mutex bidsMutex;
+		size_t entries = 0;
+		long long hits = 0;
+		long long misses = 0;
+	};
+
+	size_t maxEntries = 0; // 0 = cache is off
+	std::array<Shard, shardCount> shards;
+
+	bool enabled() const {
+		return maxEntries > 0;
+	}
+
+	// hash the values seen by the programs (bit patterns, so -0.0 and 0.0 differ).
+	// hash is FNV-1a over 64 bit words, fingerprint mixes each word with different constants.
+	static State hashState(const std::vector<double> &inputValues, const std::vector<double> &hiddenValues) {
+		State state = { 14695981039346656037ULL, 0x9E3779B97F4A7C15ULL };
+		auto add = [&state](uint64_t bits) {
+			state.hash = (state.hash ^ bits) * 1099511628211ULL;
+			uint64_t x = (state.fingerprint ^ bits) * 0xBF58476D1CE4E5B9ULL;
+			state.fingerprint = (x ^ (x >> 31)) * 0x94D049BB133111EBULL;
+		};
+		for (auto const & values : { &inputValues, &hiddenValues }) {
+			for (double v : *values) {
+				uint64_t bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				add(bits);
+			}
+			add(values->size());
+		}
+		return state;
+	}
+
+	Shard &shardOf(long programID) {
+		return shards[(unsigned long)programID % shardCount];
+	}
+
+	bool lookup(long programID, const State &state, double &bid) {
+		auto & shard = shardOf(programID);
+		std::lock_guard<std::mutex> lock(shard.bidsMutex);
+		auto program = shard.bids.find(programID);
+		if (program != shard.bids.end()) {
+			auto entry = program->second.find(state.hash);
+			if (entry != program->second.end() && entry->second.fingerprint == state.fingerprint) {
+				bid = entry->second.bid;
+				shard.hits++;
+				return true;
+			}
+		}
+		shard.misses++;
+		return false;
+	}
+
+	// a stored entry for other values with the same hash is replaced
+	void store(long programID, const State &state, double bid) {
+		auto & shard = shardOf(programID);
+		std::lock_guard<std::mutex> lock(shard.bidsMutex);
+		if (shard.entries >= std::max((size_t)1, maxEntries / shardCount)) {
+			shard.bids.clear();
+			shard.entries = 0;
+		}
+		auto inserted = shard.bids[programID].insert({ state.hash, { state.fingerprint, bid } });
+		if (inserted.second) {
+			shard.entries++;
+		}
+		else {
+			inserted.first->second = { state.fingerprint, bid };
+		}
+	}
+
+	void invalidate(long programID) {
+		auto & shard = shardOf(programID);
+		std::lock_guard<std::mutex> lock(shard.bidsMutex);
+		auto program = shard.bids.find(programID);
+		if (program != shard.bids.end()) {
+			shard.entries -= program->second.size();
+			shard.bids.erase(program);
+		}
+	}
+
+	void clear() {
+		for (auto & shard : shards) {
+			std::lock_guard<std::mutex> lock(shard.bidsMutex);
+			shard.bids.clear();
+			shard.entries = 0;
+		}
+	}
+
+	// totals over all shards, these do not lock (call when no brains are updating)
+	size_t entries() const {
+		size_t total = 0;
+		for (auto const & shard : shards) {
+			total += shard.entries;
+		}
+		return total;
+	}
+
+	long long hits() const {
+		long long total = 0;
+		for (auto const & shard : shards) {
+			total += shard.hits;
+		}
+		return total;
+	}
+
+	long long misses() const {
+		long long total = 0;
+		for (auto const & shard : shards) {
+			total += shard.misses;
+		}
+		return total;
+	}
+
+	void resetCounts() {
+		for (auto & shard : shards) {
+			shard.hits = 0;
+			shard.misses = 0;
+		}
+	}
+};
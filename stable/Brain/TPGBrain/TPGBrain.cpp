@@ -11,8 +11,11 @@
 #include "../TPGBrain/TPGBrain.h"
 #include "../../Utilities/Utilities.h"
 
-long TPGBrain::Node::nextNodeID = 0;
-long TPGBrain::Program::nextProgramID = 0;
+#include "TPGBenchmark.h"
+
+TPGBidCache TPGBrain::bidCache;
+const int TPGBrain::Program::maxRegisterSlots;
+const int TPGBrain::NodeKernel::laneWidth;
 
 std::shared_ptr<ParameterLink<int>> TPGBrain::hiddenCountPL =
 Parameters::register_parameter("BRAIN_TPG-hiddenCount",
@@ -23,6 +26,18 @@ Parameters::register_parameter("BRAIN_TPG-initalPrograms",
 std::shared_ptr<ParameterLink<int>> TPGBrain::initalNodesPL =
 Parameters::register_parameter("BRAIN_TPG-initalNodes",
 	100, "number nodes to generate at initialization");
+std::shared_ptr<ParameterLink<int>> TPGBrain::bidCacheSizePL =
+Parameters::register_parameter("BRAIN_TPG-bidCacheSize",
+	0, "if > 0, program bids are cached by program ID and input/hidden values so that programs shared by many nodes are not rerun\n"
+	"on inputs they have already seen. this is the max number of cached bids, the cache is cleared when it is full. (0 = no cache)");
+std::shared_ptr<ParameterLink<bool>> TPGBrain::selfTestPL =
+Parameters::register_parameter("BRAIN_TPG-selfTest",
+	false, "if true, the progenitor TPG brain checks the compiled program interpreters against the original interpreter\n"
+	"on random programs and inputs (made with this run's program settings) and exits if any result differs");
+std::shared_ptr<ParameterLink<std::string>> TPGBrain::loadCheckpointPL =
+Parameters::register_parameter("BRAIN_TPG-loadCheckpoint",
+	(std::string) "", "if not empty, the progenitor TPG brain loads all nodes and programs from this checkpoint file (see OPTIMIZER_TPG-saveCheckpointOn)\n"
+	"and the initial population is made from the root nodes saved in the checkpoint");
 
 std::shared_ptr<ParameterLink<int>> TPGBrain::Program::numInstructionPL =
 Parameters::register_parameter("BRAIN_TPG_PROGRAM-numInstruction",
@@ -66,100 +81,844 @@ std::shared_ptr<ParameterLink<int>> TPGBrain::Node::minProgramsPL =
 Parameters::register_parameter("BRAIN_TPG_NODE-minPrograms",
 	2, "min number of programs referenced by a Node");
 
+TPGBrain::Graph::Graph(int inputCount_, int outputCount_, int hiddenCount_)
+	:inputCount(inputCount_), outputCount(outputCount_), hiddenCount(hiddenCount_) {
+
+	numInstructions = Program::numInstructionPL->get();
+	registersSize = Program::registersSizePL->get();
+	allowRandomOp = Program::allowRandomOpPL->get();
+	numOps = allowRandomOp ? 8 : 7; // change to 8 to allow random op
+
+	mutateInstructionCodeChance = Program::mutateInstructionCodeChancePL->get();
+	mutateRegisterPresetChance = Program::mutateRegisterPresetChancePL->get();
+	mutateActionChance = Program::mutateActionChancePL->get();
+
+	mutateAddProgramChance = Node::mutateAddProgramChancePL->get();
+	mutateTradeProgramChance = Node::mutateTradeProgramChancePL->get();
+	mutateMutateProgramChance = Node::mutateMutateProgramChancePL->get();
+	mutateTradeAndMutateProgramChance = Node::mutateTradeAndMutateProgramChancePL->get();
+	mutateDeleteProgramChance = Node::mutateDeleteProgramChancePL->get();
+	maxPrograms = Node::maxProgramsPL->get();
+	minPrograms = Node::minProgramsPL->get();
+
+	atomicWidth = outputCount + hiddenCount;
+	atomicWords = std::max(1, (atomicWidth + 63) / 64);
+}
+
+std::vector<uint64_t> TPGBrain::Graph::randomAtomicBits(std::mt19937 &generator) const {
+	std::vector<uint64_t> bits(atomicWords, 0);
+	for (int i = 0; i < atomicWidth; i++) {
+		bits[i / 64] |= (uint64_t)Random::getIndex(2, generator) << (i % 64);
+	}
+	return bits;
+}
+
+int TPGBrain::Graph::internAtomic(const uint64_t *bits) {
+	uint64_t hash = 14695981039346656037ULL; // FNV-1a over 64 bit words
+	for (int w = 0; w < atomicWords; w++) {
+		hash = (hash ^ bits[w]) * 1099511628211ULL;
+	}
+	auto & bucket = atomicIndex[hash];
+	for (auto action : bucket) {
+		if (std::equal(bits, bits + atomicWords, atomicBits.begin() + (size_t)action * atomicWords)) {
+			return action;
+		}
+	}
+	int action = atomicCount();
+	atomicBits.insert(atomicBits.end(), bits, bits + atomicWords);
+	for (int i = 0; i < atomicWidth; i++) {
+		atomicValues.push_back(atomicBit(action, i));
+	}
+	bucket.push_back(action);
+	return action;
+}
+
+std::string TPGBrain::Graph::atomicString(int action) const {
+	std::string bits;
+	for (int i = 0; i < atomicWidth; i++) {
+		if (i == outputCount) {
+			bits += '|';
+		}
+		bits += atomicBit(action, i) ? '1' : '0';
+	}
+	if (hiddenCount == 0) {
+		bits += '|';
+	}
+	return bits;
+}
+
+TPGBrain::ProgramHandle TPGBrain::Graph::makeProgram() {
+	Program newProgram;
+	newProgram.ID = nextProgramID++;
+	for (int i = 0; i < numInstructions * 4; i++) { // 4 values op,in1,in2,out per instruction
+		newProgram.instructionCodes.push_back(Random::getIndex(256));
+	}
+	for (int i = 0; i < registersSize; i++) {
+		newProgram.registerPresets.push_back(Random::getDouble(1.0));
+	}
+	newProgram.actionType = 0; // initaly all programs have atomic actions
+	newProgram.atomicAction = internAtomic(randomAtomicBits(Random::getCommonGenerator()).data());
+	newProgram.compile(inputCount, hiddenCount, numOps);
+	auto ph = programs.insert(std::move(newProgram));
+	unreferencedPrograms.push_back(ph); // until a Node uses it
+	return internProgram(ph);
+}
+
+void TPGBrain::Graph::mutateProgram(Program &p, std::vector<uint64_t> &atomicBits, std::mt19937 &generator) const {
+	bool mutated = false;
+
+	while (!mutated) {
+		// change an instructionCode
+		if (Random::P(mutateInstructionCodeChance, generator)) {
+			p.instructionCodes[Random::getIndex(p.instructionCodes.size(), generator)] = Random::getIndex(256, generator);
+			mutated = true;
+		}
+		// change a registerPreset
+		if (Random::P(mutateRegisterPresetChance, generator)) {
+			p.registerPresets[Random::getIndex(p.registerPresets.size(), generator)] = Random::getDouble(1.0, generator);
+			mutated = true;
+		}
+		// change actionType / targetNode / atomic action
+		if (Random::P(mutateActionChance, generator)) {
+			p.actionType = Random::getIndex(2, generator);
+			if (p.actionType == 0) { // get new atomic values
+				p.targetNode = tpgNullHandle;
+				p.atomicAction = -1; // added to the table when the program is added to the graph
+				atomicBits = randomAtomicBits(generator);
+			}
+			else { // get a new node
+				   // why not clone targetNode if it's root?
+				   // (because it would require clone node and it's programs, but not mutation and we would end up with perfect copies...)
+				   // p is a new program so it is not in the program list of any node in the graph, it
+				   // can not point back at a node that holds it (no node->program->node loop)
+				p.targetNode = nodes.live[Random::getIndex(nodes.size(), generator)];
+				p.atomicAction = -1;
+				atomicBits.clear();
+			}
+			mutated = true;
+		}
+	}
+	p.compile(inputCount, hiddenCount, numOps);
+}
+
+TPGBrain::ProgramHandle TPGBrain::Graph::internProgram(ProgramHandle ph) {
+	auto & bucket = programIndex[programs[ph].contentHash()];
+	for (auto other : bucket) {
+		if (other == ph) {
+			return ph;
+		}
+		if (programs[other].sameContent(programs[ph])) {
+			eraseProgram(ph); // not yet referenced by any Node
+			programsDeduplicated++;
+			return other;
+		}
+	}
+	bucket.push_back(ph);
+	return ph;
+}
+
+void TPGBrain::Graph::eraseProgram(ProgramHandle ph) {
+	auto bucket = programIndex.find(programs[ph].contentHash());
+	if (bucket != programIndex.end()) {
+		auto entry = std::find(bucket->second.begin(), bucket->second.end(), ph);
+		if (entry != bucket->second.end()) {
+			*entry = bucket->second.back();
+			bucket->second.pop_back();
+		}
+		if (bucket->second.empty()) {
+			programIndex.erase(bucket);
+		}
+	}
+	bidCache.invalidate(programs[ph].ID);
+	if (programs[ph].actionType == 1) {
+		releaseNode(programs[ph].targetNode);
+	}
+	programs.erase(ph);
+}
+
+TPGBrain::NodeHandle TPGBrain::Graph::makeNode(std::vector<ProgramHandle> nodePrograms) {
+	Node newNode;
+	newNode.ID = nextNodeID++;
+	newNode.programs = std::move(nodePrograms);
+	for (auto ph : newNode.programs) {
+		programs[ph].parentCount++;
+	}
+	auto nh = nodes.insert(std::move(newNode));
+	unreferencedNodes.push_back(nh); // until it is pinned or a Program targets it
+	buildKernel(nh);
+	return nh;
+}
+
+TPGBrain::NodeHandle TPGBrain::Graph::cloneNode(NodeHandle nh) {
+	return makeNode(nodes[nh].programs); // programs is copied before makeNode inserts
+}
+
+TPGBrain::StagedNode TPGBrain::Graph::stageMutatedNode(const std::vector<ProgramHandle> &parentPrograms, std::mt19937 &generator) const {
+	StagedNode staged;
+	staged.programs = parentPrograms;
+	staged.newProgram.assign(parentPrograms.size(), -1);
+	auto & nodePrograms = staged.programs;
+	auto & newProgram = staged.newProgram;
+	// add a mutated copy of source (an existing program, or if sourceNew != -1 a new one)
+	auto addMutatedCopy = [&](ProgramHandle source, int sourceNew) {
+		Program copy = (sourceNew == -1) ? programs[source] : staged.newPrograms[sourceNew]; // copy before push_back may reallocate
+		std::vector<uint64_t> atomicBits = (sourceNew == -1) ? std::vector<uint64_t>() : staged.newAtomicBits[sourceNew];
+		mutateProgram(copy, atomicBits, generator);
+		staged.newPrograms.push_back(std::move(copy));
+		staged.newAtomicBits.push_back(std::move(atomicBits));
+		return (int)staged.newPrograms.size() - 1;
+	};
+	bool mutated = false;
+	while (!mutated) {
+		if (Random::P(mutateAddProgramChance, generator)) {
+			if ((int)nodePrograms.size() < maxPrograms) {
+				nodePrograms.push_back(programs.live[Random::getIndex(programs.size(), generator)]);
+				newProgram.push_back(-1);
+				mutated = true;
+				//
+				//
+				// must make sure program does not point to this node
+				//
+				//
+			}
+		}
+		if (Random::P(mutateTradeProgramChance, generator)) {
+			int whichProgram = Random::getIndex(nodePrograms.size(), generator);
+			nodePrograms[whichProgram] = programs.live[Random::getIndex(programs.size(), generator)];
+			newProgram[whichProgram] = -1;
+			mutated = true;
+			//
+			//
+			// must make sure program does not point to this node
+			//
+			//
+		}
+		if (Random::P(mutateMutateProgramChance, generator)) {
+			int whichProgram = Random::getIndex(nodePrograms.size(), generator);
+			newProgram[whichProgram] = addMutatedCopy(nodePrograms[whichProgram], newProgram[whichProgram]);
+			nodePrograms[whichProgram] = tpgNullHandle;
+			mutated = true;
+		}
+		if (Random::P(mutateTradeAndMutateProgramChance, generator)) {
+			int whichProgram = Random::getIndex(nodePrograms.size(), generator);
+			newProgram[whichProgram] = addMutatedCopy(programs.live[Random::getIndex(programs.size(), generator)], -1);
+			nodePrograms[whichProgram] = tpgNullHandle;
+			mutated = true;
+			//
+			//
+			// must make sure program does not point to this node
+			//
+			//
+		}
+		if (Random::P(mutateDeleteProgramChance, generator)) {
+			if ((int)nodePrograms.size() > minPrograms) {
+				int whichProgram = Random::getIndex(nodePrograms.size(), generator);
+				nodePrograms[whichProgram] = nodePrograms.back();
+				newProgram[whichProgram] = newProgram.back();
+				nodePrograms.pop_back();
+				newProgram.pop_back();
+				mutated = true;
+			}
+		}
+	} // end while !mutated
+	return staged;
+}
+
+TPGBrain::NodeHandle TPGBrain::Graph::commitStagedNode(StagedNode &staged) {
+	// add the new programs that are still used by the node (a new program may have been
+	// replaced by a later mutation), in the order they are used so IDs are deterministic
+	std::vector<ProgramHandle> committed(staged.newPrograms.size(), tpgNullHandle);
+	for (size_t i = 0; i < staged.programs.size(); i++) {
+		int n = staged.newProgram[i];
+		if (n == -1) {
+			continue;
+		}
+		if (committed[n] == tpgNullHandle) {
+			auto & p = staged.newPrograms[n];
+			p.ID = nextProgramID++;
+			p.parentCount = 0;
+			if (p.actionType == 1) {
+				nodes[p.targetNode].parentCount++;
+			}
+			else if (p.atomicAction == -1) {
+				p.atomicAction = internAtomic(staged.newAtomicBits[n].data());
+			}
+			auto ph = programs.insert(std::move(p));
+			unreferencedPrograms.push_back(ph); // in case it is dropped by internProgram
+			committed[n] = internProgram(ph);
+		}
+		staged.programs[i] = committed[n];
+	}
+	return makeNode(std::move(staged.programs));
+}
+
+TPGBrain::NodeHandle TPGBrain::Graph::cloneAndMutateNode(NodeHandle nh) {
+	auto staged = stageMutatedNode(nodes[nh].programs, Random::getCommonGenerator());
+	return commitStagedNode(staged);
+}
+
+void TPGBrain::Graph::eraseNode(NodeHandle nh) {
+	teamImages.erase(nh); // nh may be reused for a different node
+	for (auto ph : nodes[nh].programs) {
+		releaseProgram(ph);
+	}
+	nodes.erase(nh);
+}
+
+std::shared_ptr<const TPGBrain::TeamImage> TPGBrain::Graph::teamImage(NodeHandle root) {
+	auto cached = teamImages[root].lock();
+	if (cached) {
+		return cached;
+	}
+	// breadth first from root, imageIndex gives the position of each node in the image
+	auto newImage = std::make_shared<TeamImage>();
+	std::unordered_map<NodeHandle, int> imageIndex;
+	std::vector<NodeHandle> imageNodes = { root };
+	imageIndex[root] = 0;
+	for (size_t i = 0; i < imageNodes.size(); i++) {
+		for (auto ph : nodes[imageNodes[i]].programs) {
+			auto const & p = programs[ph];
+			if (p.actionType == 1 && imageIndex.find(p.targetNode) == imageIndex.end()) {
+				imageIndex[p.targetNode] = (int)imageNodes.size();
+				imageNodes.push_back(p.targetNode);
+			}
+		}
+	}
+	for (auto nh : imageNodes) {
+		auto const & n = nodes[nh];
+		newImage->nodes.push_back({ (int)newImage->actions.size(), (int)n.programs.size(), nh });
+		for (auto ph : n.programs) {
+			auto const & p = programs[ph];
+			newImage->actions.push_back({ p.actionType, (p.actionType == 1) ? imageIndex[p.targetNode] : -1, p.atomicAction, p.ID, ph });
+		}
+	}
+	teamImages[root] = newImage;
+	return newImage;
+}
+
+void TPGBrain::Graph::releaseNode(NodeHandle nh) {
+	if (--nodes[nh].parentCount == 0) {
+		unreferencedNodes.push_back(nh);
+	}
+}
+
+void TPGBrain::Graph::unpinNode(NodeHandle nh) {
+	nodes[nh].pinned = false;
+	if (nodes[nh].parentCount == 0) {
+		unreferencedNodes.push_back(nh);
+	}
+}
+
+void TPGBrain::Graph::releaseProgram(ProgramHandle ph) {
+	if (--programs[ph].parentCount == 0) {
+		unreferencedPrograms.push_back(ph);
+	}
+}
+
+void TPGBrain::Graph::collect() {
+	// erasing a Program can release a Node and erasing a Node can release Programs, so
+	// keep going until both worklists are empty. a handle on a worklist may have been
+	// erased already or be referenced again, these are skipped.
+	while (!unreferencedNodes.empty() || !unreferencedPrograms.empty()) {
+		while (!unreferencedPrograms.empty()) {
+			auto ph = unreferencedPrograms.back();
+			unreferencedPrograms.pop_back();
+			if (programs.valid(ph) && programs[ph].parentCount == 0) {
+				eraseProgram(ph);
+				programsCollected++;
+			}
+		}
+		while (!unreferencedNodes.empty()) {
+			auto nh = unreferencedNodes.back();
+			unreferencedNodes.pop_back();
+			if (nodes.valid(nh) && nodes[nh].parentCount == 0 && !nodes[nh].pinned) {
+				eraseNode(nh);
+				nodesCollected++;
+			}
+		}
+	}
+}
+
+TPGBrain::Graph::MemoryUsage TPGBrain::Graph::memoryUsage() const {
+	MemoryUsage usage;
+	for (auto nh : nodes.live) {
+		auto const & n = nodes[nh];
+		auto const & k = n.kernel;
+		usage.nodes += sizeof(Node) + n.programs.capacity() * sizeof(ProgramHandle) +
+			(k.presets.capacity() + k.ops.capacity()) * sizeof(double) +
+			(k.loadIndex.capacity() + k.loadSource.capacity() + k.in1.capacity() + k.in2.capacity() + k.out.capacity() + k.resultIndex.capacity()) * sizeof(int) +
+			k.loadHidden.capacity() + k.scalarOps.capacity();
+	}
+	for (auto ph : programs.live) {
+		auto const & p = programs[ph];
+		usage.programs += sizeof(Program) + p.code.capacity() * sizeof(Program::Instruction) + p.threaded.capacity() * sizeof(Program::ThreadedInstruction) +
+			p.loads.capacity() * sizeof(Program::Load) + p.livePresets.capacity();
+		usage.instructionCodes += p.instructionCodes.capacity() * sizeof(int);
+		usage.registerPresets += p.registerPresets.capacity() * sizeof(double);
+	}
+	usage.programIndex = programIndex.bucket_count() * sizeof(void *);
+	for (auto const & entry : programIndex) {
+		usage.programIndex += sizeof(entry) + 2 * sizeof(void *) + entry.second.capacity() * sizeof(ProgramHandle);
+	}
+	usage.atomics = (atomicBits.capacity() * sizeof(uint64_t) + atomicValues.capacity() * sizeof(double)) +
+		atomicIndex.bucket_count() * sizeof(void *);
+	for (auto const & entry : atomicIndex) {
+		usage.atomics += sizeof(entry) + 2 * sizeof(void *) + entry.second.capacity() * sizeof(int);
+	}
+	usage.teamImages = teamImages.bucket_count() * sizeof(void *);
+	for (auto const & entry : teamImages) {
+		usage.teamImages += sizeof(entry) + 2 * sizeof(void *);
+		auto image = entry.second.lock();
+		if (image) {
+			usage.teamImages += sizeof(TeamImage) + image->nodes.capacity() * sizeof(TeamImage::ImageNode) +
+				image->actions.capacity() * sizeof(TeamImage::Action);
+		}
+	}
+	usage.poolSpace = nodes.capacityBytes() - nodes.size() * sizeof(Node) +
+		programs.capacityBytes() - programs.size() * sizeof(Program);
+	return usage;
+}
+
+void TPGBrain::Graph::compact(std::vector<NodeHandle> &roots) {
+	if (!unreferencedNodes.empty() || !unreferencedPrograms.empty()) {
+		std::cout << "  in TPGBrain::Graph::compact, graph has uncollected nodes or programs (call collect() first). exiting." << std::endl;
+		exit(1);
+	}
+	handleEpoch++;
+	// new handle of each old slot
+	std::vector<NodeHandle> nodeMap(nodes.slots.size(), tpgNullHandle);
+	std::vector<ProgramHandle> programMap(programs.slots.size(), tpgNullHandle);
+
+	TPGPool<Program> newPrograms;
+	nextProgramID = 0;
+	for (auto ph : programs.live) {
+		Program p = std::move(programs[ph]);
+		p.ID = nextProgramID++;
+		p.instructionCodes.shrink_to_fit();
+		p.registerPresets.shrink_to_fit();
+		p.code.shrink_to_fit();
+		p.loads.shrink_to_fit();
+		p.livePresets.shrink_to_fit();
+		p.threaded.shrink_to_fit();
+		programMap[TPGPool<Program>::indexOf(ph)] = newPrograms.insert(std::move(p));
+	}
+	TPGPool<Node> newNodes;
+	nextNodeID = 0;
+	for (auto nh : nodes.live) {
+		Node n = std::move(nodes[nh]);
+		n.ID = nextNodeID++;
+		for (auto & ph : n.programs) {
+			ph = programMap[TPGPool<Program>::indexOf(ph)];
+		}
+		n.programs.shrink_to_fit();
+		nodeMap[TPGPool<Node>::indexOf(nh)] = newNodes.insert(std::move(n));
+	}
+	// atomic actions are renumbered in the order programs first use them
+	std::vector<uint64_t> oldAtomicBits;
+	oldAtomicBits.swap(atomicBits);
+	atomicValues.clear();
+	atomicIndex.clear();
+	programIndex.clear();
+	for (auto ph : newPrograms.live) {
+		auto & p = newPrograms[ph];
+		if (p.actionType == 1) {
+			p.targetNode = nodeMap[TPGPool<Node>::indexOf(p.targetNode)];
+		}
+		else {
+			p.atomicAction = internAtomic(&oldAtomicBits[(size_t)p.atomicAction * atomicWords]);
+		}
+		programIndex[p.contentHash()].push_back(ph);
+	}
+
+	nodes = std::move(newNodes);
+	programs = std::move(newPrograms);
+	nodes.shrinkToFit();
+	programs.shrinkToFit();
+	atomicBits.shrink_to_fit();
+	atomicValues.shrink_to_fit();
+	for (auto & nh : roots) {
+		nh = nodeMap[TPGPool<Node>::indexOf(nh)];
+	}
+	checkpointRoots.clear(); // only used while the first population is made
+	checkpointRootsUsed = 0;
+	teamImages.clear();
+	bidCache.clear();
+}
+
+void TPGBrain::Graph::buildKernel(NodeHandle nh) {
+	std::vector<const Program *> nodePrograms;
+	for (auto ph : nodes[nh].programs) {
+		nodePrograms.push_back(&programs[ph]);
+	}
+	nodes[nh].kernel = NodeKernel(nodePrograms);
+}
+
+namespace {
+	const uint32_t checkpointMagic = 0x43475054; // "TPGC"
+	const uint32_t checkpointVersion = 2;
+
+	template <class T>
+	void writeValue(std::ostream &out, const T &value) {
+		out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+
+	template <class T>
+	void writeVector(std::ostream &out, const std::vector<T> &values) {
+		writeValue(out, (uint32_t)values.size());
+		out.write(reinterpret_cast<const char *>(values.data()), values.size() * sizeof(T));
+	}
+
+	template <class T>
+	T readValue(std::istream &in) {
+		T value;
+		in.read(reinterpret_cast<char *>(&value), sizeof(T));
+		return value;
+	}
+
+	// a count read from a damaged file could ask for more memory than the machine has. the rest
+	// of the file (up to end) must hold at least minBytes for each of the count elements.
+	void checkCount(std::istream &in, uint32_t count, size_t minBytes, std::streampos end) {
+		if (!in || (unsigned long long)count * minBytes > (unsigned long long)(end - in.tellg())) {
+			std::cout << "  in TPGBrain::Graph::loadCheckpoint, checkpoint file is truncated or damaged (a count of " << count <<
+				" does not fit in the rest of the file). exiting." << std::endl;
+			exit(1);
+		}
+	}
+
+	template <class T>
+	void readVector(std::istream &in, std::vector<T> &values, std::streampos end) {
+		uint32_t count = readValue<uint32_t>(in);
+		checkCount(in, count, sizeof(T), end);
+		values.resize(count);
+		in.read(reinterpret_cast<char *>(values.data()), values.size() * sizeof(T));
+	}
+
+	// positions in the file refer to elements read earlier
+	void checkPosition(uint32_t position, size_t size) {
+		if (position >= size) {
+			std::cout << "  in TPGBrain::Graph::loadCheckpoint, checkpoint file is damaged (position " << position << " of " << size << "). exiting." << std::endl;
+			exit(1);
+		}
+	}
+}
+
+// format (native endian)
+//  header: magic, version, inputCount, outputCount, hiddenCount, numOps, nextNodeID, nextProgramID
+//  atomics: the atomic action table bits (Graph::atomicBits, atomicWords words per action)
+//  programs: count, then per program ID, actionType, atomicAction,
+//            target node (position in nodes list), registerPresets, instructionCodes
+//  nodes: count, then per node ID, programs (positions in programs list)
+//  roots: positions in nodes list
+// nodes and programs are written in pool live order, handles are not saved.
+void TPGBrain::Graph::saveCheckpoint(std::ostream &out, const std::vector<NodeHandle> &roots) const {
+	std::vector<uint32_t> programPositions(programs.slots.size());
+	for (size_t i = 0; i < programs.live.size(); i++) {
+		programPositions[TPGPool<Program>::indexOf(programs.live[i])] = (uint32_t)i;
+	}
+	std::vector<uint32_t> nodePositions(nodes.slots.size());
+	for (size_t i = 0; i < nodes.live.size(); i++) {
+		nodePositions[TPGPool<Node>::indexOf(nodes.live[i])] = (uint32_t)i;
+	}
+
+	writeValue(out, checkpointMagic);
+	writeValue(out, checkpointVersion);
+	writeValue(out, (int32_t)inputCount);
+	writeValue(out, (int32_t)outputCount);
+	writeValue(out, (int32_t)hiddenCount);
+	writeValue(out, (int32_t)numOps);
+	writeValue(out, (int64_t)nextNodeID);
+	writeValue(out, (int64_t)nextProgramID);
+	writeVector(out, atomicBits);
+
+	writeValue(out, (uint32_t)programs.size());
+	for (auto ph : programs.live) {
+		auto const & p = programs[ph];
+		writeValue(out, (int64_t)p.ID);
+		writeValue(out, (int32_t)p.actionType);
+		writeValue(out, (int32_t)p.atomicAction);
+		writeValue(out, (p.actionType == 1) ? nodePositions[TPGPool<Node>::indexOf(p.targetNode)] : (uint32_t)tpgNullHandle);
+		writeVector(out, p.registerPresets);
+		std::vector<int32_t> codes(p.instructionCodes.begin(), p.instructionCodes.end());
+		writeVector(out, codes);
+	}
+
+	writeValue(out, (uint32_t)nodes.size());
+	for (auto nh : nodes.live) {
+		auto const & n = nodes[nh];
+		writeValue(out, (int64_t)n.ID);
+		std::vector<uint32_t> nodePrograms;
+		for (auto ph : n.programs) {
+			nodePrograms.push_back(programPositions[TPGPool<Program>::indexOf(ph)]);
+		}
+		writeVector(out, nodePrograms);
+	}
+
+	std::vector<uint32_t> rootPositions;
+	for (auto nh : roots) {
+		rootPositions.push_back(nodePositions[TPGPool<Node>::indexOf(nh)]);
+	}
+	writeVector(out, rootPositions);
+}
+
+void TPGBrain::Graph::loadCheckpoint(std::istream &in) {
+	std::streampos start = in.tellg();
+	in.seekg(0, std::ios::end);
+	std::streampos end = in.tellg();
+	in.seekg(start);
+	if (readValue<uint32_t>(in) != checkpointMagic || readValue<uint32_t>(in) != checkpointVersion) {
+		std::cout << "  in TPGBrain::Graph::loadCheckpoint, file is not a TPG checkpoint (or is from a different version). exiting." << std::endl;
+		exit(1);
+	}
+	handleEpoch++;
+	int fileInputCount = readValue<int32_t>(in);
+	int fileOutputCount = readValue<int32_t>(in);
+	int fileHiddenCount = readValue<int32_t>(in);
+	if (fileInputCount != inputCount || fileOutputCount != outputCount || fileHiddenCount != hiddenCount) {
+		std::cout << "  in TPGBrain::Graph::loadCheckpoint, checkpoint has " << fileInputCount << " inputs, " << fileOutputCount << " outputs and " << fileHiddenCount <<
+			" hidden but brain has " << inputCount << ", " << outputCount << " and " << hiddenCount << ". exiting." << std::endl;
+		exit(1);
+	}
+	numOps = readValue<int32_t>(in); // programs must decode the same way they did when saved
+	allowRandomOp = numOps == 8;
+	nextNodeID = readValue<int64_t>(in);
+	nextProgramID = readValue<int64_t>(in);
+
+	nodes.clear();
+	programs.clear();
+	programIndex.clear();
+	atomicBits.clear();
+	atomicValues.clear();
+	atomicIndex.clear();
+	checkpointRoots.clear();
+	checkpointRootsUsed = 0;
+
+	std::vector<uint64_t> fileAtomicBits;
+	readVector(in, fileAtomicBits, end);
+	for (size_t i = 0; i + atomicWords <= fileAtomicBits.size(); i += atomicWords) {
+		internAtomic(&fileAtomicBits[i]); // actions in the file are unique, so they keep their index
+	}
+
+	// pools are empty, so the element at position i of the file gets the handle live[i]
+	uint32_t programCount = readValue<uint32_t>(in);
+	checkCount(in, programCount, 28, end); // ID, actionType, atomicAction, target and 2 counts
+	std::vector<uint32_t> targetPositions(programCount);
+	for (size_t i = 0; i < targetPositions.size(); i++) {
+		Program p;
+		p.ID = readValue<int64_t>(in);
+		p.actionType = readValue<int32_t>(in);
+		p.atomicAction = readValue<int32_t>(in);
+		targetPositions[i] = readValue<uint32_t>(in);
+		readVector(in, p.registerPresets, end);
+		std::vector<int32_t> codes;
+		readVector(in, codes, end);
+		p.instructionCodes.assign(codes.begin(), codes.end());
+		p.compile(inputCount, hiddenCount, numOps);
+		programs.insert(std::move(p));
+	}
+	uint32_t nodeCount = readValue<uint32_t>(in);
+	checkCount(in, nodeCount, 12, end); // ID and a count
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		Node n;
+		n.ID = readValue<int64_t>(in);
+		std::vector<uint32_t> nodePrograms;
+		readVector(in, nodePrograms, end);
+		for (auto position : nodePrograms) {
+			checkPosition(position, programs.size());
+			n.programs.push_back(programs.live[position]);
+			programs[n.programs.back()].parentCount++;
+		}
+		nodes.insert(std::move(n));
+	}
+	std::vector<uint32_t> rootPositions;
+	readVector(in, rootPositions, end);
+	if (!in || rootPositions.empty()) {
+		std::cout << "  in TPGBrain::Graph::loadCheckpoint, checkpoint file is truncated or has no root nodes. exiting." << std::endl;
+		exit(1);
+	}
+
+	for (size_t i = 0; i < targetPositions.size(); i++) {
+		auto & p = programs[programs.live[i]];
+		if (p.actionType == 1) {
+			checkPosition(targetPositions[i], nodes.size());
+			p.targetNode = nodes.live[targetPositions[i]];
+			nodes[p.targetNode].parentCount++;
+		}
+		programIndex[p.contentHash()].push_back(programs.live[i]);
+	}
+	for (auto ph : programs.live) {
+		if (programs[ph].parentCount == 0) {
+			unreferencedPrograms.push_back(ph);
+		}
+	}
+	for (auto nh : nodes.live) {
+		if (nodes[nh].parentCount == 0) { // roots are pinned when makeBrain hands them out
+			unreferencedNodes.push_back(nh);
+		}
+	}
+	for (auto nh : nodes.live) {
+		buildKernel(nh);
+	}
+	for (auto position : rootPositions) {
+		checkPosition(position, nodes.size());
+		checkpointRoots.push_back(nodes.live[position]);
+	}
+}
+
 // this will be called by main (which does not know about nodes to create inital population)
 std::shared_ptr<AbstractBrain> TPGBrain::makeBrain(
 	std::unordered_map<std::string, 
-	std::shared_ptr<AbstractGenome>> &_genomes) {
-	auto avaliblePrograms = *rootNode->allPrograms;
-	auto avalibleNodes = *avaliblePrograms[0]->allNodes;
-	auto newRootNode = avalibleNodes[Random::getIndex(avalibleNodes.size())];
-	return std::make_shared<TPGBrain>(nrInputValues, nrOutputValues, nrHidden, newRootNode, PT);
+	std::shared_ptr<AbstractGenome>> & /*_genomes*/) {
+	NodeHandle newRootNode;
+	if (graph->checkpointRootsUsed < graph->checkpointRoots.size()) { // rebuild the population saved in a checkpoint
+		newRootNode = graph->checkpointRoots[graph->checkpointRootsUsed++];
+	}
+	else { // each organism of the initial population gets a new node with 2 random programs
+		newRootNode = graph->makeNode({ graph->randomProgram(), graph->randomProgram() });
+	}
+	graph->nodes[newRootNode].pinned = true;
+	return std::make_shared<TPGBrain>(nrInputValues, nrOutputValues, nrHidden, graph, newRootNode, PT);
+}
+
+void TPGBrain::runSelfTest(const Graph &graph) {
+	if (TPGBenchmark::selfTest(graph, std::cout) > 0) {
+		std::cout << "  in TPGBrain::runSelfTest, compiled programs do not match Program::evaluateReference. exiting." << std::endl;
+		exit(1);
+	}
 }
 
+#ifdef TPG_BENCHMARK
+void TPGBrain::runBenchmark(const Graph &graph) {
+	TPGBenchmark::run(graph, std::cout);
+}
+#endif
+
+// counters for TPGBrain::profile, these compile to nothing unless built with -DTPG_PROFILE
+#ifdef TPG_PROFILE
+#define TPG_PROFILE_ADD(counter, amount) (profile.counter += (amount))
+#else
+#define TPG_PROFILE_ADD(counter, amount)
+#endif
+
 void TPGBrain::update() {
-	std::vector<std::shared_ptr<Node>> visitedNodes; // list of nodes visited this update
+	// traversal state lives in this brain (visits) and not in the shared image, so
+	// brains that share an image can be updated at the same time on different threads.
+	// all scratch space is kept between updates so that update() does not allocate.
+	if (!rootValid()) {
+		std::cout << "  in TPGBrain::update, the root node of this brain is no longer in the TPG graph (it was erased or the graph was compacted)."
+			"\n  only brains in the current population can be updated. exiting." << std::endl;
+		exit(1);
+	}
+	auto const & team = *image;
+	if (visitOfNode.size() != team.nodes.size()) {
+		scratchGrowths++;
+		visitOfNode.assign(team.nodes.size(), -1);
+	}
+	visitCount = 0;
+#ifdef TPG_PROFILE
+	profile.updates++;
+	if (profile.actionWins.size() != team.actions.size()) {
+		profile.actionWins.assign(team.actions.size(), 0);
+	}
+#endif
 
-	auto currentNode = rootNode;
+	int currentNode = 0; // root node
 	bool foundAtomic = false;
 
-	while (!foundAtomic) {
-		//std::cout << "in loop    currentNode has " << currentNode->programs.size() << " programs." << std::endl;
-		if (currentNode->visitCounter == 0) { // first time at this node in this update. run and rank programs
-											  //std::cout << "visit couter is 0" << std::endl;
+	bool useBidCache = bidCache.enabled();
+	TPGBidCache::State state = { 0, 0 };
+	if (useBidCache) { // inputs and hidden do not change during traversal
+		state = TPGBidCache::hashState(inputValues, hiddenValues);
+	}
 
-			visitedNodes.push_back(currentNode); // add to list of nodes to clean up later.
+	while (!foundAtomic) {
+		auto const & node = team.nodes[currentNode];
+		auto const * nodeActions = &team.actions[node.firstAction];
+		NodeVisit *visit = nullptr;
+		TPG_PROFILE_ADD(steps, 1);
+		if (visitOfNode[currentNode] != -1) {
+			visit = &visits[visitOfNode[currentNode]];
+			TPG_PROFILE_ADD(revisits, 1);
+		}
+		else { // first time at this node in this update. run programs
+			if (visitCount == visits.size()) {
+				scratchGrowths++;
+				visits.emplace_back();
+			}
+			visitOfNode[currentNode] = (int)visitCount;
+			visit = &visits[visitCount++];
+			visit->node = currentNode;
+			TPG_PROFILE_ADD(nodesVisited, 1);
 
-			std::vector<std::pair<size_t, double>> programBids; // index in programs list, value generated by program
-			for (size_t i = 0; i < currentNode->programs.size(); i++) {
-				programBids.push_back({ i, currentNode->programs[i]->evaluate(inputValues,hiddenValues) });
+			auto const & kernel = graph->nodes[node.node].kernel;
+			if (bidValues.capacity() < (size_t)node.actionCount) {
+				scratchGrowths++;
 			}
-			//std::cout << "got program bids" << std::endl;
-
-			for (size_t i = 0; i < currentNode->programs.size(); i++) {
-				double maxBid = programBids[0].second;
-				size_t maxBidIndex = 0;
-				for (size_t j = 1; j < programBids.size(); j++) { // find highest in remaining bids
-					if (programBids[j].second > maxBid) {
-						maxBid = programBids[j].second;
-						maxBidIndex = j;
+			bidValues.resize(node.actionCount);
+			if (kernel.usable) { // all bids in one pass
+				bool allCached = useBidCache;
+				if (useBidCache) {
+					for (int i = 0; i < node.actionCount; i++) {
+						if (bidCache.lookup(nodeActions[i].programID, state, bidValues[i])) {
+							bidCacheHits++;
+						}
+						else {
+							bidCacheMisses++;
+							allCached = false;
+						}
+					}
+				}
+				if (!allCached) {
+					TPG_PROFILE_ADD(programEvals, node.actionCount);
+					auto registersCapacity = kernelRegisters.capacity();
+					kernel.evaluate(inputValues.data(), hiddenValues.data(), bidValues.data(), kernelRegisters);
+					if (kernelRegisters.capacity() != registersCapacity) {
+						scratchGrowths++;
+					}
+					if (useBidCache) {
+						for (int i = 0; i < node.actionCount; i++) {
+							bidCache.store(nodeActions[i].programID, state, bidValues[i]);
+						}
 					}
 				}
-
-				currentNode->programOrder.push_back(programBids[maxBidIndex].first);
-				programBids[maxBidIndex] = programBids.back();
-				programBids.pop_back();
 			}
-			//std::cout << "reorder is done" << std::endl;
-			//for (auto po : currentNode->programOrder) {
-			//	std::cout << "(" << currentNode->ID << ") program #: "<< po << " (" << currentNode->programs[po]->ID << " has score: " << currentNode->programs[po]->evaluate(inputValues, hiddenValues) << "  and action type: " << currentNode->programs[po]->actionType << std::endl;
-			//}
-		} // end run and rank programs
+			else {
+				TPG_PROFILE_ADD(programEvals, node.actionCount);
+				for (int i = 0; i < node.actionCount; i++) {
+					bidValues[i] = graph->programs[nodeActions[i].program].evaluate(inputValues, hiddenValues);
+				}
+			}
 
-		  // follow program indicated by visit
-		  // if visit = programs.size() return Atomic 0
+			if (visit->remainingBids.capacity() < (size_t)node.actionCount) {
+				scratchGrowths++;
+			}
+			visit->remainingBids.clear();
+			for (int i = 0; i < node.actionCount; i++) {
+				visit->remainingBids.push_back({ i, bidValues[i] });
+			}
+		} // end run programs
 
-		if (currentNode->programs.size() <= currentNode->visitCounter) {
+		// follow the highest bid program that has not been followed yet
+		// if all programs have been followed return Atomic 0
+		int winner = visit->nextProgram();
+		if (winner == -1) {
 			//std::cout << "no more programs - we are done!" << std::endl;
 			resetOutputs();
 			foundAtomic = true;
 		}
 		else { // follow path of wining program
-			if (currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->actionType == 0) { // this program references an atomic action
-																												//std::cout << "found atomic!  " << currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->targetAtomic << " : " << currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->targetHidden << std::endl;
-				auto newOutput = intToBoolVector(currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->targetAtomic);
-				auto newHidden = intToBoolVector(currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->targetHidden);
-
-				std::fill(outputValues.begin(), outputValues.end(), 0); // insure that they are empty in case newValues don't set all bits
-				std::fill(hiddenValues.begin(), hiddenValues.end(), 0);
-
-				//std::cout << newOutput.size() << "  " << newHidden.size() << std::endl;
-				//std::cout << outputValues.size() << "  " << hiddenValues.size() << std::endl;
-				for (size_t i = 0; i < newOutput.size(); i++) {
-					//	std::cout << i << ":" << newOutput[i] << " " << std::flush;
-					outputValues[i] = newOutput[i];
-				}
-				//std::cout << std::endl;
-				for (size_t i = 0; i < newHidden.size(); i++) {
-					//std::cout << i << ":" << newHidden[i] << " " << std::flush;
-					hiddenValues[i] = newHidden[i];
-				}
-				//std::cout << std::endl;
-				//std::cout << "done atomic!" << std::endl;
-
+			auto const & action = nodeActions[winner];
+			TPG_PROFILE_ADD(actionWins[node.firstAction + winner], 1);
+			if (action.actionType == 0) { // this program references an atomic action
+				graph->applyAtomic(action.atomicAction, outputValues, hiddenValues);
 				foundAtomic = true;
 			}
 			else { // this program reference a node
-				//   std::cout << "found node!  " << currentNode->programs[currentNode->programOrder[currentNode->visitCounter]]->targetNode->ID << std::endl;
-				currentNode->visitCounter++;
-				currentNode = currentNode->programs[currentNode->programOrder[currentNode->visitCounter - 1]]->targetNode;
-				//std::cout << "currentNode advaced!" << std::endl;
+				currentNode = action.targetNode;
 			}
 		}
 	}
-
-	for (auto n : visitedNodes) { // we are done, clean up this mess!
-		n->visitCounter = 0;
-		n->programOrder.clear();
+	for (size_t v = 0; v < visitCount; v++) { // ready for the next update
+		visitOfNode[visits[v].node] = -1;
 	}
 }
 
@@ -168,75 +927,70 @@ TPGBrain::makeCopy(std::shared_ptr<ParametersTable> PT_) {
   if (PT_ == nullptr) {
     PT_ = PT;
   }
-  return std::make_shared<TPGBrain>(nrInputValues, nrOutputValues, hiddenCountPL->get(PT), rootNode, PT_);;
-}
-
-void TPGBrain::DetectParts(const std::shared_ptr<Node> &n,
-	std::set<std::shared_ptr<Node>> &saveNodes, 
-	std::set<std::shared_ptr <Program>> &savePrograms,
-	std::set<std::string> &visitedElements) {
-
-	auto nName = "N" + std::to_string(n->ID);
-	visitedElements.insert(nName);
-	saveNodes.insert(n);
-	for (auto p : n->programs) {
-		auto pName = "P" + std::to_string(p->ID);
-		if (visitedElements.find(pName) == visitedElements.end()) { // if this program is not known
-			visitedElements.insert(pName);
-			savePrograms.insert(p);
-			if (p->actionType == 1) {
-				auto tnName = "N" + std::to_string(p->targetNode->ID);
-				if (visitedElements.find(tnName) == visitedElements.end()) {
-					DetectParts(p->targetNode, saveNodes, savePrograms, visitedElements);
-				}
+  return std::make_shared<TPGBrain>(nrInputValues, nrOutputValues, hiddenCountPL->get(PT), graph, rootNode, PT_);
+}
+
+void TPGBrain::DetectParts(NodeHandle nh,
+	std::set<NodeHandle> &saveNodes,
+	std::set<ProgramHandle> &savePrograms) {
+
+	saveNodes.insert(nh);
+	for (auto ph : graph->nodes[nh].programs) {
+		if (savePrograms.insert(ph).second) { // if this program is not known
+			auto const & p = graph->programs[ph];
+			if (p.actionType == 1 && saveNodes.find(p.targetNode) == saveNodes.end()) {
+				DetectParts(p.targetNode, saveNodes, savePrograms);
 			}
 		}
 	}
-
-
 };
 
 // convert a brain into data map with data that can be saved to file
 // format
 //  nodes = ID#pID:pID:...:|ID-pID:pID:...:...|...
 //  programs = ID#aType-[aOut/aHid or nID]#registerPreset:registerPreset:#instructionCode:instructionCodes:|...|...
-DataMap TPGBrain::serialize(std::string &name) {
+DataMap TPGBrain::serialize(std::string & /*name*/) {
 	DataMap dataMap;
-	std::shared_ptr<Node> n = rootNode;
-	std::set<std::shared_ptr<Node>> saveNodes;
-	std::set<std::shared_ptr<Program>> savePrograms;
-	std::set<std::string> visitedElements;
+	std::set<NodeHandle> saveNodes;
+	std::set<ProgramHandle> savePrograms;
 
-	dataMap.set("rootNode", std::to_string(rootNode->ID));
+	if (!rootValid()) {
+		std::cout << "  in TPGBrain::serialize, the root node of this brain is no longer in the TPG graph (it was erased or the graph was compacted)."
+			"\n  only brains in the current population can be saved. exiting." << std::endl;
+		exit(1);
+	}
+	dataMap.set("rootNode", std::to_string(graph->nodes[rootNode].ID));
 
-	DetectParts(n, saveNodes, savePrograms, visitedElements);
+	DetectParts(rootNode, saveNodes, savePrograms);
 
 	std::stringstream ss;
 	ss << saveNodes.size() << "#"; // how many nodes?
-	for (auto n : saveNodes) {
-		ss << n->ID << "#" << n->programs.size() << "#"; // how many programs in this node
-		for (auto p : n->programs) {
-			ss << p->ID << "#";
+	for (auto nh : saveNodes) {
+		auto const & n = graph->nodes[nh];
+		ss << n.ID << "#" << n.programs.size() << "#"; // how many programs in this node
+		for (auto ph : n.programs) {
+			ss << graph->programs[ph].ID << "#";
 		}
 	}
 	dataMap.set("nodes", ss.str());
 	ss.str(std::string()); // clear ss
 	ss << savePrograms.size() << "#"; // how many programs
-	for (auto p : savePrograms) {
-		ss << p->ID << "#" << p->actionType << "#";
-		if (p->actionType == 0){ // atomic
-			//if atomic then save output value / hidden value
-			ss << p->targetAtomic << "#" << p->targetHidden << "#";
+	for (auto ph : savePrograms) {
+		auto const & p = graph->programs[ph];
+		ss << p.ID << "#" << p.actionType << "#";
+		if (p.actionType == 0){ // atomic
+			//if atomic then save output values | hidden values
+			ss << graph->atomicString(p.atomicAction) << "#";
 		} else { // node
 			// if node then node id
-			ss << p->targetNode->ID << "#";
+			ss << graph->nodes[p.targetNode].ID << "#";
 		}
-		for (auto val : p->registerPresets) {
+		for (auto val : p.registerPresets) {
 			// write each preset program value
 			ss << val << "#";
 		}
 		// # to sperate preset values and instruction codes
-		for (auto val : p->instructionCodes) {
+		for (auto val : p.instructionCodes) {
 			// write each instruction code
 			ss << val << "#";
 		}
@@ -247,77 +1001,33 @@ DataMap TPGBrain::serialize(std::string &name) {
 }
 
 // given an unordered_map<string, string> and PT, load data into this brain
-void TPGBrain::deserialize(std::shared_ptr<ParametersTable> PT,
+// nodes and programs are not read from orgData, they are loaded once for the whole
+// population from a checkpoint (BRAIN_TPG-loadCheckpoint). only the rootNode ID is
+// read here and the node with that ID is looked up in the loaded graph.
+void TPGBrain::deserialize(std::shared_ptr<ParametersTable> /*PT*/,
 	std::unordered_map<std::string, std::string> &orgData,
 	std::string &name) {
-/*
-// this is too much of a pain in the ass to write. it can be done
-// if needed, but at the moment, I don't see the value in it.
-// below is the begining of the code needed
-// the complexity comes from the fact that the nodes
-// and programs lists saved with each org are the nodes
-// and programs for that org. when being deserialized checks
-// must be preformed for each node and program to see if
-// they are already in allNodes or allPrograms. Also
-// nodes and programs must be correctly linked (this is
-// a pain. Perhaps a better way would be to save all
-// nodes and programs will every org. Then if !fromFile
-// would result in a read of all programs and nodes and
-// assignment of rootNode for that first brain. Thereafter
-// fromFile == true, so all that would be needed to be set
-// is the rootNode for each Brain.
-
 	if (name == "root::") {
 		name = "";
 	}
-	std::string nodesName = name + "nodes";
-	std::string programsName = name + "programs";
-	std::vector<std::string> nodes_data;
-	convertCSVListToVector(orgData[nodesName],nodes_data,'#');
-	std::vector<std::string> programs_data;
-	convertCSVListToVector(orgData[programsName], programs_data,'#');
-
-	auto temp_allNodes = (*rootNode->allPrograms)[0]->allNodes;
-	//if this is the first brain being deserialized, reset programs and brains
-	if (!rootNode->fromFile) {
-		(*rootNode->allPrograms)[0]->allNodes->clear();
-		rootNode->allPrograms->clear();
-	}
-
-	size_t read_index = 0; // use this to read nodes and programs
-	int nCount, nID, pCount, value;
-	stringToValue(nodes_data[read_index++], nCount);
-	for (int i = 0; i < nCount; i++) {
-		// for each node
-		stringToValue(nodes_data[read_index++], nID);
-		// if node is in allNodes
-		bool new_node = true;
-		for (auto const & n : *temp_allNodes) {
-			if (n->ID == nID) {
-				new_node == false;
+	long rootID;
+	if (orgData.find(name + "rootNode") == orgData.end() || !stringToValue(orgData[name + "rootNode"], rootID)) {
+		std::cout << "  in TPGBrain::deserialize, could not find " << name << "rootNode in org data. exiting." << std::endl;
+		exit(1);
+	}
+	for (auto nh : graph->nodes.live) {
+		if (graph->nodes[nh].ID == rootID) {
+			// makeBrain pinned the root this brain was made with, it is released (and collected
+			// if nothing else uses it) and the loaded root is pinned in it's place
+			if (nh != rootNode && graph->nodes.valid(rootNode)) {
+				graph->unpinNode(rootNode);
 			}
-		}
-		if (new_node == false) {
-			// skip to next node. first get number of programs in this node
-			stringToValue(nodes_data[read_index++], pCount);
-			// now skip that number of values
-			read_index += pCount;
-		}
-		else {
-			// this node needs to be added to temp_allNodes;
-
+			graph->nodes[nh].pinned = true;
+			setRootNode(nh);
+			return;
 		}
 	}
-
-
-
-	*/
-
-	// read out the nodes
-	
-	//std::cout << "nodes_data: " << nodes_data << std::endl;
-	//std::cout << "programs_data: " << programs_data << std::endl;
-
-	//
+	std::cout << "  in TPGBrain::deserialize, node " << rootID << " is not in the TPG graph."
+		"\n  TPG organisms can only be loaded with the checkpoint (BRAIN_TPG-loadCheckpoint) saved with them. exiting." << std::endl;
+	exit(1);
 }
-
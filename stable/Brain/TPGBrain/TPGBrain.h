@@ -10,74 +10,55 @@
 
 #pragma once
 
+#include <algorithm>
 #include <cmath>
+#include <cstring>
+#include <fstream>
+#include <limits>
 #include <memory>
 #include <iostream>
 #include <set>
+#include <unordered_map>
 #include <vector>
 
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+// Program::evaluateThreaded dispatches with computed goto (labels as values) where the
+// compiler supports it. define TPG_NO_COMPUTED_GOTO to use the portable switch instead.
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(TPG_NO_COMPUTED_GOTO)
+#define TPG_COMPUTED_GOTO
+#endif
+
 #include "../../Genome/AbstractGenome.h"
 
 #include "../../Utilities/Random.h"
 
 #include "../AbstractBrain.h"
 
+#include "TPGBidCache.h"
+#include "TPGPool.h"
+
 class TPGBrain : public AbstractBrain {
 public:
 
 	static std::shared_ptr<ParameterLink<int>> hiddenCountPL;
 	static std::shared_ptr<ParameterLink<int>> initalProgramsPL;
 	static std::shared_ptr<ParameterLink<int>> initalNodesPL;
+	static std::shared_ptr<ParameterLink<int>> bidCacheSizePL;
+	static std::shared_ptr<ParameterLink<bool>> selfTestPL;
+	static std::shared_ptr<ParameterLink<std::string>> loadCheckpointPL;
 
-	class Node;
+	static TPGBidCache bidCache; // shared by all brains, programs are shared by all brains
 
-	void graphTPG(std::shared_ptr<Node> n, std::set<std::string> &visitedElements, std::string &graphEdges, std::string &graphProps) {
-		auto nName = "N" + std::to_string(n->ID);
-		visitedElements.insert(nName);
-		graphProps += nName + " [color=yellow,shape=ellipse,style=filled]\n";
-		for (auto p : n->programs) {
-			auto pName = "P" + std::to_string(p->ID);
-			graphEdges += "  " + nName + " -> " + pName + "\n";
-			if (visitedElements.find(pName) == visitedElements.end()) { // if this program is not known
-				visitedElements.insert(pName);
-				graphProps += pName + " [color=springGreen,shape=ellipse,style=filled]\n";
-
-				if (p->actionType == 0) {
-					auto aName = "A" + std::to_string(p->targetAtomic) + "h" + std::to_string(p->targetHidden);
-					graphEdges += "  " + pName + " -> " + aName + "\n";
-					if (visitedElements.find(aName) == visitedElements.end()) {
-						visitedElements.insert(aName);
-						graphProps += aName + " [color=lightgrey,shape=component,style=filled]\n";
-					}
-				}
-				else {
-					auto tnName = "N" + std::to_string(p->targetNode->ID);
-					graphEdges += "  " + pName + " -> " + tnName + "\n";
-					if (visitedElements.find(tnName) == visitedElements.end()) {
-						visitedElements.insert(tnName);
-						graphTPG(p->targetNode, visitedElements, graphEdges, graphProps); // repeat process for this node;
-					}
-				}
-			}
-		}
-	}
+	class Node;
+	class Program;
+	class Graph;
 
-	std::vector <bool> intToBoolVector(int value, bool flipOrder = false) {
-		std::vector <bool> result;
-		while (value > 0) { // pull out one bit at a time creating vector with least signifigent bit in the first position
-			result.push_back(value & 1);
-			value >>= 1;
-			//std::cout << value << "  " << result.size() << "  " << result.back() << std::endl;
-		}
-		if (flipOrder) {
-			for (int i = 0; i < int(result.size()) / 2; i++) { // flip vector (edcba -> abdce)
-				auto temp = result[i];
-				result[i] = result[(result.size() - 1) - i];
-				result[(result.size() - 1) - i] = temp;
-			}
-		}
-		return result;
-	}
+	// Nodes and Programs are stored in the pools of a Graph and are referenced by handle
+	typedef TPGHandle NodeHandle;
+	typedef TPGHandle ProgramHandle;
 
 	class Program {
 		// okay here we go. fast cgp...
@@ -92,20 +73,62 @@ public:
 		// operator, operand, operand, output, operator, operand, operand, output, ... operator, operand, operand
 
 	public:
-		long ID;
-		int inputCount, outputCount, hiddenCount;
+		long ID = -1;
 		// code here
-		int actionType; // 0 = atomic, 1 = node
-		std::shared_ptr<Node> targetNode = nullptr;
-		std::shared_ptr<std::vector<std::shared_ptr<Node>>> allNodes;
+		int actionType = 0; // 0 = atomic, 1 = node
+		NodeHandle targetNode = tpgNullHandle;
 
-		long long targetAtomic; // either actual value of output, or index into atomics list
-		long long targetHidden; // if action is atomic, then set hidden to this.
+		int atomicAction = -1; // index in the Graph atomic table (if actionType == 0)
 		int parentCount = 0; // number of Nodes referencing this Program
 
 		std::vector<int> instructionCodes;
 		std::vector<double> registerPresets;
 
+		// compiled form of instructionCodes. built by compile() whenever instructionCodes
+		// or registerPresets change so that evaluate() does not need to decode anything.
+		// instruction codes are in [0,256) so no operand can address a slot past 255, this
+		// lets evaluate() use a fixed size register file on the stack.
+		static const int maxRegisterSlots = 256;
+
+		enum OpCode : unsigned char { ADD = 0, SUB, MUL, DIV, SINCOS, GREATER, NEGATE, RANDOM };
+
+		struct Instruction {
+			OpCode op;
+			unsigned char in1, in2, out; // register file slots
+		};
+
+		struct Load {
+			unsigned char slot; // register file slot
+			bool hidden; // if true read from hidden, else from inputs
+			int index;
+		};
+
+		// op of a threaded code instruction. the first 8 are the OpCodes, the others are
+		// specialised forms that compile() picks from the operands of an instruction.
+		enum ThreadedOp : unsigned char {
+			T_ADD = ADD, T_SUB, T_MUL, T_DIV, T_SINCOS, T_GREATER, T_NEGATE, T_RANDOM,
+			T_TWICE, // x + x
+			T_SQUARE, // x * x
+			T_DIVIDE, // x / y, y is a preset that can not be near 0 (no test needed)
+			T_ZERO, // x > x, or x / y with y a preset near 0
+			T_HALT // end of program, returns the result register
+		};
+
+		struct ThreadedInstruction {
+			ThreadedOp op;
+			unsigned char in1, in2, out;
+		};
+
+		std::vector<Instruction> code;
+		std::vector<ThreadedInstruction> threaded; // code as run by evaluate(), ends with T_HALT
+		std::vector<Load> loads; // input and hidden values read by code
+		std::vector<unsigned char> livePresets; // preset slots read before they are written, other presets can not change the bid
+		int presetSlots = 0; // number of registerPresets copied into the register file
+		int slotCount = 0; // presetSlots + loads.size()
+		int resultSlot = 0; // register holding the bid after code has run
+		bool usesRandomOp = false; // code contains RANDOM
+		bool usesSinCos = false; // code contains SINCOS
+
 		static std::shared_ptr<ParameterLink<int>> numInstructionPL;
 		static std::shared_ptr<ParameterLink<int>> registersSizePL;
 		static std::shared_ptr<ParameterLink<bool>> allowRandomOpPL;
@@ -114,129 +137,266 @@ public:
 		static std::shared_ptr<ParameterLink<double>> mutateRegisterPresetChancePL;
 		static std::shared_ptr<ParameterLink<double>> mutateActionChancePL;
 
+		// decode instructionCodes into code, loads, presetSlots, slotCount and resultSlot.
+		// only the result register is read after the program has run, so a backward
+		// liveness pass drops every instruction whose output can not reach it (introns).
+		// code is the effective program, input and hidden values read by the code are
+		// given dense slots after the presets so the register file only needs slotCount entries.
+		void compile(int inputCount, int hiddenCount, int numOps) {
+			int registersSize = (int)registerPresets.size();
+			int numInstructions = (int)instructionCodes.size() / 4;
+			int totalSlots = registersSize + inputCount + hiddenCount; // size of the register file in evaluateReference
+			presetSlots = std::min(registersSize, maxRegisterSlots);
+			resultSlot = instructionCodes.back() % registersSize;
+
+			// decode with operands as slots of the full register file
+			std::vector<Instruction> decoded(numInstructions);
+			for (int i = 0; i < numInstructions; i++) {
+				decoded[i].op = static_cast<OpCode>(instructionCodes[(i * 4)] % numOps);
+				decoded[i].in1 = instructionCodes[(i * 4) + 1] % totalSlots;
+				decoded[i].in2 = instructionCodes[(i * 4) + 2] % totalSlots;
+				decoded[i].out = instructionCodes[(i * 4) + 3] % registersSize;
+			}
 
-		int numInstructions;
-		int numInstructionsCodes; // 4 values op,in1,in2,out per instruction
-		int registersSize;
-		bool allowRandomOp;
-
-		int numOps; // change to 8 to allow random op
-
-		double mutateInstructionCodeChance;
-		double mutateRegisterPresetChance;
-		double mutateActionChance;
-
-		static long nextProgramID;
-
-		Program(int inputCount_, int outputCount_, int hiddenCount_, std::shared_ptr<std::vector<std::shared_ptr<Node>>> allNodes_)
-			:inputCount(inputCount_), outputCount(outputCount_), hiddenCount(hiddenCount_), allNodes(allNodes_) {
-
-			mutateInstructionCodeChance = mutateInstructionCodeChancePL->get();
-			mutateRegisterPresetChance = mutateRegisterPresetChancePL->get();
-			mutateActionChance = mutateActionChancePL->get();
-			registersSize = registersSizePL->get();
+			// liveness, from the last instruction back. RANDOM is always kept so that the
+			// number of random draws made by the program does not change.
+			std::vector<bool> liveSlots(maxRegisterSlots, false);
+			std::vector<bool> keep(numInstructions, false);
+			liveSlots[resultSlot] = true;
+			for (int i = numInstructions - 1; i >= 0; i--) {
+				auto const & inst = decoded[i];
+				if (liveSlots[inst.out] || inst.op == RANDOM) {
+					keep[i] = true;
+					liveSlots[inst.out] = false; // value before this instruction is not read
+					liveSlots[inst.in1] = true;
+					if (inst.op != NEGATE) { // negate ignores in2
+						liveSlots[inst.in2] = true;
+					}
+				}
+			}
 
-			numInstructions = numInstructionPL->get();
-			numInstructionsCodes = numInstructions * 4; // 4 values op,in1,in2,out per instruction
+			code.clear();
+			loads.clear();
+			usesRandomOp = false;
+			std::vector<int> slotMap(maxRegisterSlots, -1);
+			auto mapSlot = [&](int slot) {
+				if (slot < registersSize) {
+					return slot;
+				}
+				if (slotMap[slot] == -1) { // first time this input or hidden value is read
+					slotMap[slot] = presetSlots + (int)loads.size();
+					int source = slot - registersSize;
+					loads.push_back({ static_cast<unsigned char>(slotMap[slot]), source >= inputCount, (source >= inputCount) ? source - inputCount : source });
+				}
+				return slotMap[slot];
+			};
+			for (int i = 0; i < numInstructions; i++) {
+				if (keep[i]) {
+					auto inst = decoded[i];
+					inst.in1 = mapSlot(inst.in1);
+					inst.in2 = mapSlot(inst.in2);
+					code.push_back(inst);
+					usesRandomOp = usesRandomOp || inst.op == RANDOM;
+				}
+			}
+			slotCount = presetSlots + (int)loads.size();
+			livePresets.clear();
+			for (int slot = 0; slot < presetSlots; slot++) {
+				if (liveSlots[slot]) {
+					livePresets.push_back(slot);
+				}
+			}
 
-			allowRandomOp = allowRandomOpPL->get();
-			numOps = allowRandomOp ? 8 : 7; // change to 8 to allow random op
+			// threaded code. a preset slot that has not been written yet holds its preset, so
+			// the divide by zero test of a division by it can be done here.
+			threaded.clear();
+			usesSinCos = false;
+			std::vector<bool> written(maxRegisterSlots, false);
+			for (auto const & inst : code) {
+				ThreadedInstruction t = { static_cast<ThreadedOp>(inst.op), inst.in1, inst.in2, inst.out };
+				if (inst.op == ADD && inst.in1 == inst.in2) {
+					t.op = T_TWICE;
+				}
+				else if (inst.op == MUL && inst.in1 == inst.in2) {
+					t.op = T_SQUARE;
+				}
+				else if (inst.op == GREATER && inst.in1 == inst.in2) {
+					t.op = T_ZERO;
+				}
+				else if (inst.op == DIV && inst.in2 < presetSlots && !written[inst.in2]) {
+					t.op = (registerPresets[inst.in2] < (std::numeric_limits<double>::min() * 2)) ? T_ZERO : T_DIVIDE;
+				}
+				usesSinCos = usesSinCos || inst.op == SINCOS;
+				written[inst.out] = true;
+				threaded.push_back(t);
+			}
+			threaded.push_back({ T_HALT, 0, 0, 0 });
+		}
 
-			ID = nextProgramID++;
-			for (int i = 0; i < numInstructionsCodes; i++) {
-				instructionCodes.push_back(Random::getIndex(256));
+		// hash of everything that can change what this program does: its action and its
+		// effective program (code, loads, result slot and the presets the code reads).
+		// programs with the same contentHash and sameContent() behave the same.
+		uint64_t contentHash() const {
+			uint64_t hash = 14695981039346656037ULL; // FNV-1a over 64 bit words
+			auto add = [&hash](uint64_t word) {
+				hash = (hash ^ word) * 1099511628211ULL;
+			};
+			add(actionType);
+			add(actionType == 0 ? (uint64_t)atomicAction : (uint64_t)targetNode);
+			add(resultSlot);
+			for (auto const & inst : code) {
+				add(inst.op | (inst.in1 << 8) | (inst.in2 << 16) | ((uint64_t)inst.out << 24));
 			}
-			for (int i = 0; i < registersSize; i++) {
-				registerPresets.push_back(Random::getDouble(1.0));
+			for (auto const & l : loads) {
+				add(l.slot | (l.hidden << 8) | ((uint64_t)l.index << 16));
 			}
-			actionType = 0; // initaly all programs have atomic actions
-			targetAtomic = Random::getIndex(std::pow(2.0, (double(outputCount))));
-			targetHidden = Random::getIndex(std::pow(2.0, (double(hiddenCount)))); // set this to the bit size or index from list
+			for (auto slot : livePresets) {
+				uint64_t bits;
+				std::memcpy(&bits, &registerPresets[slot], sizeof(bits));
+				add(slot);
+				add(bits);
+			}
+			return hash;
 		}
 
-		std::shared_ptr<Program> clone() {
-			auto newProgram = std::make_shared<Program>(inputCount, outputCount, hiddenCount, allNodes);
-			newProgram->actionType = actionType;
-			newProgram->targetAtomic = targetAtomic;
-			newProgram->targetHidden = targetHidden;
-			newProgram->targetNode = targetNode;
-			newProgram->instructionCodes = instructionCodes;
-			newProgram->registerPresets = registerPresets;
-			if (newProgram->actionType == 1) {
-				newProgram->targetNode->parentCount++;
+		bool sameContent(const Program &other) const {
+			if (actionType != other.actionType || resultSlot != other.resultSlot ||
+				code.size() != other.code.size() || loads.size() != other.loads.size() || livePresets != other.livePresets) {
+				return false;
+			}
+			if (actionType == 0 ? atomicAction != other.atomicAction : targetNode != other.targetNode) {
+				return false;
+			}
+			for (size_t i = 0; i < code.size(); i++) {
+				if (code[i].op != other.code[i].op || code[i].in1 != other.code[i].in1 ||
+					code[i].in2 != other.code[i].in2 || code[i].out != other.code[i].out) {
+					return false;
+				}
+			}
+			for (size_t i = 0; i < loads.size(); i++) {
+				if (loads[i].slot != other.loads[i].slot || loads[i].hidden != other.loads[i].hidden || loads[i].index != other.loads[i].index) {
+					return false;
+				}
+			}
+			for (auto slot : livePresets) { // compare bit patterns, as the bid cache does
+				if (std::memcmp(&registerPresets[slot], &other.registerPresets[slot], sizeof(double)) != 0) {
+					return false;
+				}
 			}
-			return newProgram;
+			return true;
 		}
 
-		void mutate() {
-			bool mutated = false;
+		// number of instructions that can change the bid (size of the effective program)
+		int effectiveLength() const {
+			return (int)code.size();
+		}
 
-			while (!mutated) {
-				// change an instructionCode
-				if (Random::P(mutateInstructionCodeChance)) {
-					instructionCodes[Random::getIndex(instructionCodes.size())] = Random::getIndex(256);
-					mutated = true;
-				}
-				// change a registerPreset
-				if (Random::P(mutateRegisterPresetChance)) {
-					registerPresets[Random::getIndex(registerPresets.size())] = Random::getDouble(1.0);
-					mutated = true;
-				}
-				// change actionType / targetNode / targetAtomic / targetHidden
-				if (Random::P(mutateActionChance)) {
-					if (actionType == 1) { // if action type was node, then we must decrese the parent Count before we unlink
-						targetNode->parentCount--;
-						targetNode = nullptr;
-					}
-					actionType = Random::getIndex(2);
-					if (actionType == 0) { // get new atomic values
-						targetAtomic = Random::getIndex(std::pow(2.0, (double(outputCount)))); // set this to the bit size or index from list
-						targetHidden = Random::getIndex(std::pow(2.0, (double(hiddenCount)))); // set this to the bit size or index from list
-					}
-					else { // get a new node
-						   // why not clone targetNode if it's root?
-						   // (because it would require clone node and it's programs, but not mutation and we would end up with perfect copies...)
-
-						   // this should not be needed, we already dropped this above if actionType was 1
-						   //if (targetNode != nullptr) {
-						   //    targetNode->parentCount--;
-						   //}
-						
-						bool goodTargetNode = false; // set this to false to get into the while loop
-						// while loop is here to make sure that we don't create a node->program->node loop
-						while (goodTargetNode == false) {
-							targetNode = (*allNodes)[Random::getIndex((*allNodes).size())];
-							// check to insure that program is not pointing at a node with this program in it's list
-							goodTargetNode = true; // assume all is good
-							for (auto const & p : targetNode->programs) {
-								if (p->actionType == 1 && p->ID == ID) {
-									// the node we just picked has this program in it's list!
-									goodTargetNode = false;
-								}
-							}
-						}
-						targetNode->parentCount++;
-					}
-					mutated = true;
+		// run the compiled program. inputs and hidden are read in place, neither is copied.
+		double evaluate(const double *inputs, const double *hidden) const {
+			return (usesSinCos || usesRandomOp) ? evaluateThreaded<true>(inputs, hidden) : evaluateThreaded<false>(inputs, hidden);
+		}
+
+		// direct threaded interpreter for threaded. with TPG_COMPUTED_GOTO each handler jumps
+		// straight to the next one, otherwise a switch in a loop is used. withSinCos = false is the fast path for code
+		// without SINCOS and RANDOM, it makes no calls so the register file stays in registers
+		// and cache.
+		template <bool withSinCos>
+		double evaluateThreaded(const double *inputs, const double *hidden) const {
+			double r[maxRegisterSlots];
+			std::copy(registerPresets.begin(), registerPresets.begin() + presetSlots, r);
+			for (auto const & l : loads) {
+				r[l.slot] = l.hidden ? hidden[l.index] : inputs[l.index];
+			}
+			const ThreadedInstruction *ip = threaded.data();
+#ifdef TPG_COMPUTED_GOTO
+			static void *const handlers[] = { &&add, &&sub, &&mul, &&div, &&sincos, &&greater, &&negate, &&random,
+				&&twice, &&square, &&divide, &&zero, &&halt };
+#define TPG_HANDLER(label, op) label:
+#define TPG_NEXT goto *handlers[(++ip)->op]
+			goto *handlers[ip->op];
+#else
+#define TPG_HANDLER(label, op) case op:
+#define TPG_NEXT ip++; continue
+			for (;;) {
+				switch (ip->op) {
+#endif
+				TPG_HANDLER(add, T_ADD) r[ip->out] = r[ip->in1] + r[ip->in2]; TPG_NEXT;
+				TPG_HANDLER(sub, T_SUB) r[ip->out] = r[ip->in1] - r[ip->in2]; TPG_NEXT;
+				TPG_HANDLER(mul, T_MUL) r[ip->out] = r[ip->in1] * r[ip->in2]; TPG_NEXT;
+				TPG_HANDLER(div, T_DIV) r[ip->out] = (r[ip->in2] < (std::numeric_limits<double>::min() * 2)) ? 0 : r[ip->in1] / r[ip->in2]; TPG_NEXT;
+				TPG_HANDLER(sincos, T_SINCOS) if (withSinCos) { r[ip->out] = std::sin(r[ip->in1]) + std::cos(r[ip->in2]); } TPG_NEXT;
+				TPG_HANDLER(greater, T_GREATER) r[ip->out] = (r[ip->in1] > r[ip->in2]) ? 1 : 0; TPG_NEXT;
+				TPG_HANDLER(negate, T_NEGATE) r[ip->out] = -1 * r[ip->in1]; TPG_NEXT;
+				TPG_HANDLER(random, T_RANDOM) if (withSinCos) { r[ip->out] = Random::getDouble(std::min(r[ip->in1], r[ip->in2]), std::max(r[ip->in1], r[ip->in2])); } TPG_NEXT;
+				TPG_HANDLER(twice, T_TWICE) { double x = r[ip->in1]; r[ip->out] = x + x; } TPG_NEXT;
+				TPG_HANDLER(square, T_SQUARE) { double x = r[ip->in1]; r[ip->out] = x * x; } TPG_NEXT;
+				TPG_HANDLER(divide, T_DIVIDE) r[ip->out] = r[ip->in1] / r[ip->in2]; TPG_NEXT;
+				TPG_HANDLER(zero, T_ZERO) r[ip->out] = 0; TPG_NEXT;
+				TPG_HANDLER(halt, T_HALT) return r[resultSlot];
+#ifndef TPG_COMPUTED_GOTO
 				}
 			}
+#endif
+#undef TPG_HANDLER
+#undef TPG_NEXT
 		}
 
-		std::shared_ptr<Program> cloneAndMutate() {
-			auto newProgram = clone();
-			newProgram->mutate();
-			return newProgram;
+		// run code with a switch per instruction. this was evaluate() before threaded code was
+		// added, it is kept so TPGBenchmark can compare the two.
+		double evaluateSwitch(const double *inputs, const double *hidden) const {
+			double registers[maxRegisterSlots];
+			std::copy(registerPresets.begin(), registerPresets.begin() + presetSlots, registers);
+			for (auto const & l : loads) {
+				registers[l.slot] = l.hidden ? hidden[l.index] : inputs[l.index];
+			}
+			for (auto const & inst : code) {
+				double operand1 = registers[inst.in1];
+				double operand2 = registers[inst.in2];
+				switch (inst.op) {
+				case ADD:
+					registers[inst.out] = operand1 + operand2;
+					break;
+				case SUB:
+					registers[inst.out] = operand1 - operand2;
+					break;
+				case MUL:
+					registers[inst.out] = operand1 * operand2;
+					break;
+				case DIV:
+					registers[inst.out] = (operand2 < (std::numeric_limits<double>::min() * 2)) ? 0 : operand1 / operand2;
+					break;
+				case SINCOS:
+					registers[inst.out] = std::sin(operand1) + std::cos(operand2);
+					break;
+				case GREATER:
+					registers[inst.out] = (operand1 > operand2) ? 1 : 0;
+					break;
+				case NEGATE:
+					registers[inst.out] = -1 * operand1;
+					break;
+				case RANDOM:
+					registers[inst.out] = Random::getDouble(std::min(operand1, operand2), std::max(operand1, operand2));
+					break;
+				} // end switch
+			} // end operations loop
+			return registers[resultSlot];
 		}
 
-		double evaluate(std::vector<double> inputValues, std::vector<double> hiddenValues) {
+		double evaluate(const std::vector<double> &inputValues, const std::vector<double> &hiddenValues) const {
+			return evaluate(inputValues.data(), hiddenValues.data());
+		} // end evaluate function
+
+		// original interpreter, decodes instructionCodes on every call. this is kept as the
+		// reference that compiled evaluate() must match (see TPGBenchmark::selfTest).
+		double evaluateReference(const std::vector<double> &inputValues, const std::vector<double> &hiddenValues, int numOps) const {
 			std::vector<double> registers = registerPresets; // load registers with 1.0
 			for (size_t i = 0; i < inputValues.size(); i++) {
 				registers.push_back(inputValues[i]);
 			}
-			for (size_t i = 0; i < hiddenCount; i++) {
+			for (size_t i = 0; i < hiddenValues.size(); i++) {
 				registers.push_back(hiddenValues[i]);
 			}
-			for (size_t i = 0; i < numInstructions; i++) {
+			for (size_t i = 0; i < instructionCodes.size() / 4; i++) {
 				double operand1 = registers[instructionCodes[(i * 4) + 1] % registers.size()];
 				double operand2 = registers[instructionCodes[(i * 4) + 2] % registers.size()];
 				int outputIndex = instructionCodes[(i * 4) + 3] % registerPresets.size();
@@ -273,25 +433,169 @@ public:
 					break;
 				} // end switch
 			} // end operations loop
-			return registers[instructionCodes.back() % registersSize];
-		} // end evaluate function
+			return registers[instructionCodes.back() % registerPresets.size()];
+		} // end evaluateReference function
 	}; // end program
 
+	// all programs of a Node laid out side by side (structure of arrays) so that every
+	// bid of the node can be computed in one pass. Each program is a lane, registers
+	// are stored [slot][lane] and every instruction is run for all lanes before moving
+	// on to the next instruction. When compiled with AVX2 four lanes are run at a time,
+	// otherwise a scalar loop over the lanes is used. The results are identical to
+	// calling Program::evaluate on each program.
+	class NodeKernel {
+	public:
+		static const int laneWidth = 4; // doubles per AVX2 register
+
+		int programCount = 0;
+		int lanes = 0; // programCount rounded up to laneWidth
+		int numInstructions = 0; // longest program, shorter programs are padded
+		int slotCount = 0; // largest register file + 1 sink slot used by padding
+		bool usable = true; // false if a program uses the random op (the order of random draws would change)
+
+		std::vector<double> presets; // [slot][lane]
+		std::vector<int> loadIndex; // register index (slot * lanes + lane) for each load
+		std::vector<char> loadHidden; // same as Program::Load::hidden
+		std::vector<int> loadSource; // same as Program::Load::index
+		std::vector<double> ops; // [instruction][lane] OpCode stored as double for AVX2 compares
+		std::vector<int> in1, in2, out; // [instruction][lane] register index (slot * lanes + lane)
+		std::vector<char> scalarOps; // [instruction][lane block] true if any lane in block needs SINCOS
+		std::vector<int> resultIndex; // [lane] register index holding bid
+
+		NodeKernel() = default;
+
+		NodeKernel(const std::vector<const Program *> &programs) {
+			programCount = (int)programs.size();
+			lanes = ((programCount + laneWidth - 1) / laneWidth) * laneWidth;
+			for (auto const & p : programs) {
+				numInstructions = std::max(numInstructions, (int)p->code.size());
+				slotCount = std::max(slotCount, p->slotCount);
+				usable = usable && !p->usesRandomOp;
+			}
+			int sink = slotCount++;
+			int blocks = lanes / laneWidth;
+			presets.assign(slotCount * lanes, 0.0);
+			ops.assign(numInstructions * lanes, (double)Program::ADD);
+			in1.resize(numInstructions * lanes);
+			in2.resize(numInstructions * lanes);
+			out.resize(numInstructions * lanes);
+			scalarOps.assign(numInstructions * blocks, false);
+			resultIndex.assign(lanes, sink * lanes);
+			for (int lane = 0; lane < lanes; lane++) {
+				for (int i = 0; i < numInstructions; i++) { // padding: sink = sink + sink
+					in1[i * lanes + lane] = in2[i * lanes + lane] = out[i * lanes + lane] = sink * lanes + lane;
+				}
+				if (lane >= programCount) {
+					continue;
+				}
+				auto const & p = programs[lane];
+				for (int slot = 0; slot < p->presetSlots; slot++) {
+					presets[slot * lanes + lane] = p->registerPresets[slot];
+				}
+				for (auto const & l : p->loads) {
+					loadIndex.push_back(l.slot * lanes + lane);
+					loadHidden.push_back(l.hidden);
+					loadSource.push_back(l.index);
+				}
+				for (int i = 0; i < (int)p->code.size(); i++) {
+					auto const & inst = p->code[i];
+					ops[i * lanes + lane] = (double)inst.op;
+					in1[i * lanes + lane] = inst.in1 * lanes + lane;
+					in2[i * lanes + lane] = inst.in2 * lanes + lane;
+					out[i * lanes + lane] = inst.out * lanes + lane;
+					if (inst.op == Program::SINCOS || inst.op == Program::RANDOM) {
+						scalarOps[i * blocks + lane / laneWidth] = true;
+					}
+				}
+				resultIndex[lane] = p->resultSlot * lanes + lane;
+			}
+		}
+
+		static double scalarOp(int op, double operand1, double operand2) {
+			switch (op) {
+			case Program::ADD:
+				return operand1 + operand2;
+			case Program::SUB:
+				return operand1 - operand2;
+			case Program::MUL:
+				return operand1 * operand2;
+			case Program::DIV:
+				return (operand2 < (std::numeric_limits<double>::min() * 2)) ? 0 : operand1 / operand2;
+			case Program::SINCOS:
+				return std::sin(operand1) + std::cos(operand2);
+			case Program::GREATER:
+				return (operand1 > operand2) ? 1 : 0;
+			case Program::NEGATE:
+				return -1 * operand1;
+			default: // RANDOM
+				return Random::getDouble(std::min(operand1, operand2), std::max(operand1, operand2));
+			}
+		}
+
+		// write programCount bids to bids. registers is scratch space, it is resized as needed.
+		void evaluate(const double *inputs, const double *hidden, double *bids, std::vector<double> &registers) const {
+			registers.resize(slotCount * lanes);
+			std::copy(presets.begin(), presets.end(), registers.begin());
+			for (size_t l = 0; l < loadIndex.size(); l++) {
+				registers[loadIndex[l]] = loadHidden[l] ? hidden[loadSource[l]] : inputs[loadSource[l]];
+			}
+			double *r = registers.data();
+#ifdef __AVX2__
+			int blocks = lanes / laneWidth;
+			const __m256d tiny = _mm256_set1_pd(std::numeric_limits<double>::min() * 2);
+			const __m256d one = _mm256_set1_pd(1.0);
+			const __m256d minusOne = _mm256_set1_pd(-1.0);
+			const __m256d zero = _mm256_setzero_pd();
+#endif
+			for (int i = 0; i < numInstructions; i++) {
+				int base = i * lanes;
+#ifdef __AVX2__
+				for (int b = 0; b < blocks; b++) {
+					int at = base + b * laneWidth;
+					__m256d operand1 = _mm256_i32gather_pd(r, _mm_loadu_si128((const __m128i *)&in1[at]), 8);
+					__m256d operand2 = _mm256_i32gather_pd(r, _mm_loadu_si128((const __m128i *)&in2[at]), 8);
+					__m256d op = _mm256_loadu_pd(&ops[at]);
+					__m256d quotient = _mm256_div_pd(operand1, operand2);
+					quotient = _mm256_blendv_pd(quotient, zero, _mm256_cmp_pd(operand2, tiny, _CMP_LT_OQ));
+					__m256d result = _mm256_add_pd(operand1, operand2);
+					result = _mm256_blendv_pd(result, _mm256_sub_pd(operand1, operand2), _mm256_cmp_pd(op, _mm256_set1_pd(Program::SUB), _CMP_EQ_OQ));
+					result = _mm256_blendv_pd(result, _mm256_mul_pd(operand1, operand2), _mm256_cmp_pd(op, _mm256_set1_pd(Program::MUL), _CMP_EQ_OQ));
+					result = _mm256_blendv_pd(result, quotient, _mm256_cmp_pd(op, _mm256_set1_pd(Program::DIV), _CMP_EQ_OQ));
+					result = _mm256_blendv_pd(result, _mm256_and_pd(_mm256_cmp_pd(operand1, operand2, _CMP_GT_OQ), one), _mm256_cmp_pd(op, _mm256_set1_pd(Program::GREATER), _CMP_EQ_OQ));
+					result = _mm256_blendv_pd(result, _mm256_mul_pd(minusOne, operand1), _mm256_cmp_pd(op, _mm256_set1_pd(Program::NEGATE), _CMP_EQ_OQ));
+					double results[laneWidth];
+					_mm256_storeu_pd(results, result);
+					if (scalarOps[i * blocks + b]) { // sin and cos have no AVX2 instruction
+						for (int lane = 0; lane < laneWidth; lane++) {
+							int op = (int)ops[at + lane];
+							if (op == Program::SINCOS || op == Program::RANDOM) {
+								results[lane] = scalarOp(op, r[in1[at + lane]], r[in2[at + lane]]);
+							}
+						}
+					}
+					for (int lane = 0; lane < laneWidth; lane++) { // lanes write to their own column, no conflicts
+						r[out[at + lane]] = results[lane];
+					}
+				}
+#else
+				for (int lane = 0; lane < lanes; lane++) {
+					r[out[base + lane]] = scalarOp((int)ops[base + lane], r[in1[base + lane]], r[in2[base + lane]]);
+				}
+#endif
+			}
+			for (int lane = 0; lane < programCount; lane++) {
+				bids[lane] = r[resultIndex[lane]];
+			}
+		}
+	}; // end NodeKernel
+
 	class Node {
 	public:
-		int ID;
-		bool fromFile = false; // this is used when loading populations
-							// a check will be made on the first node in
-							// allNodes when deserialize is called. If 
-							// from file is false, then allNodes and
-							// allPrograms will be cleared (of initial
-							// nodes and programs) so that they can be
-							// filled with loaded nodes and programs.
-		std::shared_ptr<std::vector<std::shared_ptr<Program>>> allPrograms;
-		std::vector<std::shared_ptr<Program>> programs;
-		std::vector<int> programOrder; // used to store program indexes ordered by their 'score'
-		int visitCounter = 0; // number of times this node has been visted in this brain update
+		long ID = -1;
+		std::vector<ProgramHandle> programs;
+		NodeKernel kernel; // programs laid out for evaluation, rebuilt by Graph::buildKernel when programs changes
 		int parentCount = 0; // number of Actions referencing this Node
+		bool pinned = false; // root node of an organism, not collected while parentCount is 0
 
 		static std::shared_ptr<ParameterLink<double>> mutateAddProgramChancePL;
 		static std::shared_ptr<ParameterLink<double>> mutateTradeProgramChancePL;
@@ -301,6 +605,60 @@ public:
 
 		static std::shared_ptr<ParameterLink<int>> maxProgramsPL;
 		static std::shared_ptr<ParameterLink<int>> minProgramsPL;
+	}; // end node
+
+	// read only copy of the structure of the part of the graph that can be reached from one
+	// root node, laid out in a few contiguous arrays (root is node 0). node kernels are not
+	// copied, update() runs the kernel kept on the graph Node.
+	// edges are indexes into these arrays rather than handles, so a traversal does not
+	// touch the graph pools. made by Graph::teamImage and shared by brains with the same root.
+	class TeamImage {
+	public:
+		struct Action { // one per program of each node, in node program order
+			int actionType; // 0 = atomic, 1 = node
+			int targetNode; // index in nodes (if actionType == 1)
+			int atomicAction; // index in the Graph atomic table (if actionType == 0)
+			long programID; // for the bid cache
+			ProgramHandle program; // used if the node kernel is not usable
+		};
+		struct ImageNode {
+			int firstAction; // index in actions
+			int actionCount;
+			NodeHandle node; // for the node's kernel, which stays in the graph (one copy per node, not per image)
+		};
+
+		std::vector<ImageNode> nodes;
+		std::vector<Action> actions;
+	}; // end team image
+
+	// a mutated Node that has not been added to a Graph (see Graph::stageMutatedNode)
+	struct StagedNode {
+		std::vector<ProgramHandle> programs; // program list, tpgNullHandle where a new program is used
+		std::vector<int> newProgram; // per entry of programs, index in newPrograms or -1
+		std::vector<Program> newPrograms; // mutated copies, compiled, no ID yet
+		// per new program, the bits of a new atomic action (see Graph::atomicWords) to be
+		// added to the atomic table on commit, or empty if atomicAction is already set
+		std::vector<std::vector<uint64_t>> newAtomicBits;
+	};
+
+	// all Nodes and Programs of a TPG population, and the settings used to make and mutate
+	// them. The progenitor brain makes the Graph and every brain made from it shares it.
+	// parentCount on Nodes and Programs is the only reference count. when a count drops to
+	// 0 (or a Node or Program is made with a count of 0) the handle is put on a worklist,
+	// collect() erases everything on the worklists that is still unreferenced (and not
+	// pinned), following Program -> Node and Node -> Program edges in the same pass.
+	class Graph {
+	public:
+		int inputCount, outputCount, hiddenCount;
+
+		int numInstructions;
+		int registersSize;
+		bool allowRandomOp;
+		int numOps; // 8 if random op is allowed, else 7
+
+		double mutateInstructionCodeChance;
+		double mutateRegisterPresetChance;
+		double mutateActionChance;
 
 		double mutateAddProgramChance;
 		double mutateTradeProgramChance;
@@ -311,106 +669,224 @@ public:
 		int maxPrograms;
 		int minPrograms;
 
-		static long nextNodeID;
+		long nextNodeID = 0;
+		long nextProgramID = 0;
+
+		// atomic actions (the output and hidden values set by a program with an atomic action).
+		// each action is stored once, as atomicWidth bits (outputs then hidden, atomicWords
+		// 64 bit words) and as atomicWidth doubles so update() can copy them in place.
+		// programs refer to actions by index, actions are only removed by compact().
+		int atomicWidth; // outputCount + hiddenCount
+		int atomicWords; // at least 1
+		std::vector<uint64_t> atomicBits; // atomicWords per action
+		std::vector<double> atomicValues; // atomicWidth per action
+		std::unordered_map<uint64_t, std::vector<int>> atomicIndex; // hash of bits -> actions
+
+		int atomicCount() const {
+			return (int)(atomicBits.size() / atomicWords);
+		}
+		bool atomicBit(int action, int bit) const {
+			return (atomicBits[(size_t)action * atomicWords + bit / 64] >> (bit % 64)) & 1;
+		}
+		// atomicWords words with atomicWidth random bits
+		std::vector<uint64_t> randomAtomicBits(std::mt19937 &generator) const;
+		// index of the action with these bits (atomicWords words), added if it is new
+		int internAtomic(const uint64_t *bits);
+		// set outputs and hidden to the values of action
+		void applyAtomic(int action, std::vector<double> &outputs, std::vector<double> &hidden) const {
+			auto values = atomicValues.begin() + (size_t)action * atomicWidth;
+			std::copy(values, values + outputs.size(), outputs.begin());
+			std::copy(values + outputs.size(), values + outputs.size() + hidden.size(), hidden.begin());
+		}
+		// outputs then hidden as '0'/'1', with a '|' between them (used in reports)
+		std::string atomicString(int action) const;
+
+		TPGPool<Node> nodes;
+		TPGPool<Program> programs;
+
+		// made and mutated programs are interned by content (see Program::contentHash) so a
+		// program that is the same as one already in the graph is replaced by the existing one.
+		std::unordered_map<uint64_t, std::vector<ProgramHandle>> programIndex; // content hash -> programs
+		long long programsDeduplicated = 0; // programs dropped by internProgram
+
+		// handles whose parentCount was 0 at some point since the last collect() (may be stale)
+		std::vector<NodeHandle> unreferencedNodes;
+		std::vector<ProgramHandle> unreferencedPrograms;
+		long long nodesCollected = 0; // erased by collect()
+		long long programsCollected = 0;
 
-		Node(std::shared_ptr<std::vector<std::shared_ptr<Program>>> allPrograms_)
-			:allPrograms(allPrograms_) {
+		// root nodes of the population saved in the checkpoint this graph was loaded from.
+		// makeBrain hands these out in order so the loaded population is rebuilt.
+		std::vector<NodeHandle> checkpointRoots;
+		size_t checkpointRootsUsed = 0;
 
-			mutateAddProgramChance = mutateAddProgramChancePL->get();
-			mutateTradeProgramChance = mutateTradeProgramChancePL->get();
-			mutateMutateProgramChance = mutateMutateProgramChancePL->get();
-			mutateTradeAndMutateProgramChance = mutateTradeAndMutateProgramChancePL->get();
-			mutateDeleteProgramChance = mutateDeleteProgramChancePL->get();
-			maxPrograms = maxProgramsPL->get();
-			minPrograms = minProgramsPL->get();
+		// advanced whenever every handle changes (compact and loadCheckpoint), handles from
+		// before then may look valid but refer to other nodes
+		long long handleEpoch = 0;
 
-			ID = nextNodeID++;
+		Graph(int inputCount_, int outputCount_, int hiddenCount_);
+
+		NodeHandle randomNode() const {
+			return nodes.live[Random::getIndex(nodes.size())];
+		}
+		ProgramHandle randomProgram() const {
+			return programs.live[Random::getIndex(programs.size())];
 		}
 
-		std::shared_ptr<Node> clone() {
-			auto newNode = std::make_shared<Node>(allPrograms);
-			newNode->programs = programs;
-			for (auto p : newNode->programs) {
-				p->parentCount++;
+		ProgramHandle makeProgram(); // new random program with an atomic action
+		// p is a copy that is not in the graph. if its atomic action changes, atomicAction is
+		// set to -1 and the new bits are put in atomicBits (to be added with internAtomic)
+		void mutateProgram(Program &p, std::vector<uint64_t> &atomicBits, std::mt19937 &generator) const;
+		ProgramHandle internProgram(ProgramHandle ph); // returns ph or an existing program with the same content (ph is then erased)
+		void eraseProgram(ProgramHandle ph); // releases targetNode
+
+		NodeHandle makeNode(std::vector<ProgramHandle> nodePrograms); // adds a reference to each program
+		NodeHandle cloneNode(NodeHandle nh);
+		// mutated copy of a node with parentPrograms. only reads the graph, so nodes can be
+		// staged on several threads (each with its own generator) and then committed.
+		// the graph must hold at least one node (a mutation may point a program at one).
+		StagedNode stageMutatedNode(const std::vector<ProgramHandle> &parentPrograms, std::mt19937 &generator) const;
+		NodeHandle commitStagedNode(StagedNode &staged); // adds the node and its new programs to the graph
+		NodeHandle cloneAndMutateNode(NodeHandle nh); // stage and commit with the common generator
+		void eraseNode(NodeHandle nh); // releases programs
+
+		void buildKernel(NodeHandle nh);
+
+		// images are cached by root node (while a brain holds them) and dropped when the root
+		// is erased. the part of the graph reachable from a node does not change once the
+		// node has been made and mutated, so images never need to be rebuilt.
+		std::unordered_map<NodeHandle, std::weak_ptr<const TeamImage>> teamImages;
+		std::shared_ptr<const TeamImage> teamImage(NodeHandle root);
+
+		// drop one reference, the Node or Program is put on the worklist if this was the last
+		void releaseNode(NodeHandle nh);
+		void releaseProgram(ProgramHandle ph);
+		// the Node is no longer an organism's root, it is put on the worklist if nothing targets it
+		void unpinNode(NodeHandle nh);
+		// erase unreferenced Programs and unreferenced, unpinned Nodes. work done is
+		// proportional to the number of handles put on the worklists, not to the graph size.
+		void collect();
+
+		// binary checkpoint of every node and program (each stored once), the ID counters and
+		// the population root nodes. loadCheckpoint replaces the contents of this graph and
+		// sets checkpointRoots. file format is native endian, see saveCheckpoint.
+		void saveCheckpoint(std::ostream &out, const std::vector<NodeHandle> &roots) const;
+		void loadCheckpoint(std::istream &in);
+
+		// bytes held by the graph. live elements are counted by category, poolSpace is pool
+		// capacity that is not used by a live element (released by compact()).
+		struct MemoryUsage {
+			size_t nodes = 0; // Node objects, their program lists and kernels
+			size_t programs = 0; // Program objects and their compiled code
+			size_t instructionCodes = 0;
+			size_t registerPresets = 0;
+			size_t programIndex = 0;
+			size_t atomics = 0; // atomic action table and its index
+			size_t teamImages = 0; // images still held by brains and the image cache
+			size_t poolSpace = 0;
+
+			size_t used() const {
+				return nodes + programs + instructionCodes + registerPresets + programIndex + atomics + teamImages;
 			}
-			return newNode;
-		}
+		};
+		MemoryUsage memoryUsage() const;
 
-		void mutate() {
-			bool mutated = false;
-			while (!mutated) {
-				if (Random::P(mutateAddProgramChance)) {
-					if (programs.size() < maxPrograms) {
-						programs.push_back((*allPrograms)[Random::getIndex((*allPrograms).size())]);
-						programs.back()->parentCount++;
-						mutated = true;
-						//
-						//
-						// must make sure program does not point to this node
-						//
-						//
-					}
-				}
-				if (Random::P(mutateTradeProgramChance)) {
-					int whichProgram = Random::getIndex(programs.size());
-					programs[whichProgram]->parentCount--;
-					programs[whichProgram] = (*allPrograms)[Random::getIndex((*allPrograms).size())];
-					programs[whichProgram]->parentCount++;
-					mutated = true;
-					//
-					//
-					// must make sure program does not point to this node
-					//
-					//
-				}
-				if (Random::P(mutateMutateProgramChance)) {
-					int whichProgram = Random::getIndex(programs.size());
-					programs[whichProgram]->parentCount--;
-					programs[whichProgram] = programs[whichProgram]->cloneAndMutate();
-					programs[whichProgram]->parentCount++;
-					(*allPrograms).push_back(programs[whichProgram]);
-					mutated = true;
-				}
-				if (Random::P(mutateTradeAndMutateProgramChance)) {
-					int whichProgram = Random::getIndex(programs.size());
-					programs[whichProgram]->parentCount--;
-					programs[whichProgram] = (*allPrograms)[Random::getIndex((*allPrograms).size())]->cloneAndMutate();
-					programs[whichProgram]->parentCount++;
-					(*allPrograms).push_back(programs[whichProgram]);
-					mutated = true;
-					//
-					//
-					// must make sure program does not point to this node
-					//
-					//
-				}
-				if (Random::P(mutateDeleteProgramChance)) {
-					if (programs.size() > minPrograms) {
-						int whichProgram = Random::getIndex(programs.size());
-						programs[whichProgram]->parentCount--;
-						programs[whichProgram] = programs.back();
-						programs.pop_back();
-						mutated = true;
-					}
-				}
-			} // end while !mutated
-		} // end mutate()
+		// rebuild both pools with only the live elements, in live order, renumber node and
+		// program IDs from 0, drop atomic actions no program uses and release unused capacity. every handle changes: roots is
+		// remapped, other handles held outside the graph are invalid (brains must be given
+		// their new root with setRootNode). worklists must be empty (call collect() first).
+		// team images and the bid cache (keyed by program ID) are cleared.
+		void compact(std::vector<NodeHandle> &roots);
+	}; // end graph
 
-		std::shared_ptr<Node> cloneAndMutate() {
-			auto newNode = clone();
-			newNode->mutate();
-			return newNode;
-		}
 
-	}; // end node
 
+	std::shared_ptr<Graph> graph;
+	NodeHandle rootNode = tpgNullHandle;
+	std::shared_ptr<const TeamImage> image; // rootNode and what it can reach, used by update()
+	long long imageEpoch = -1; // graph->handleEpoch when image was made
 
+	void buildImage() {
+		image = graph->teamImage(rootNode);
+		imageEpoch = graph->handleEpoch;
+	}
 
-	std::shared_ptr<Node> rootNode;
+	// false if rootNode was erased or the graph was compacted since this brain was given it.
+	// brains outside the population (copies, archived organisms) are not updated by the
+	// optimizer and can not be used once this is false.
+	bool rootValid() const {
+		return graph->nodes.valid(rootNode) && imageEpoch == graph->handleEpoch;
+	}
 
 	int nrHidden;
 	std::vector<double> hiddenValues;
 
+	// per update traversal state for one node, kept in the brain so that Nodes are not
+	// written to during update()
+	struct NodeVisit {
+		int node; // index in image->nodes
+		// bids of programs that have not been followed yet (index in programs list, bid).
+		// programs are not ranked up front, nextProgram() pulls out the highest remaining
+		// bid only when it is needed, most updates follow the first program.
+		std::vector<std::pair<int, double>> remainingBids;
+
+		int nextProgram() {
+			if (remainingBids.empty()) {
+				return -1;
+			}
+			double maxBid = remainingBids[0].second;
+			size_t maxBidIndex = 0;
+			for (size_t j = 1; j < remainingBids.size(); j++) { // find highest in remaining bids
+				if (remainingBids[j].second > maxBid) {
+					maxBid = remainingBids[j].second;
+					maxBidIndex = j;
+				}
+			}
+			int program = remainingBids[maxBidIndex].first;
+			remainingBids[maxBidIndex] = remainingBids.back();
+			remainingBids.pop_back();
+			return program;
+		}
+	};
+	std::vector<NodeVisit> visits; // scratch space for update(), reused between updates
+	size_t visitCount = 0; // entries of visits used in this update
+	std::vector<int> visitOfNode; // per image node, index in visits or -1 if not visited in this update
+
+	std::vector<double> bidValues; // scratch space for update(), bids for the current node
+	std::vector<double> kernelRegisters; // scratch space for NodeKernel::evaluate
+
+	// number of times a scratch buffer used by update() had to grow. once every node
+	// this brain can reach has been visited this stops changing, i.e. update() no
+	// longer allocates (unless bidCache is on, the cache allocates as it fills).
+	// reported by getStats as TPG_scratchGrowths.
+	long long scratchGrowths = 0;
+
+	long long bidCacheHits = 0; // bids read from bidCache by this brain
+	long long bidCacheMisses = 0;
+
+#ifdef TPG_PROFILE
+	// execution counters, only built with -DTPG_PROFILE (see getStats)
+	struct Profile {
+		long long updates = 0;
+		long long nodesVisited = 0; // nodes whose programs were run
+		long long steps = 0; // nodes stepped through, the traversal depth summed over updates
+		long long revisits = 0; // steps to a node already visited in the same update (next highest bid is followed)
+		long long programEvals = 0; // programs run (bids read from bidCache are not counted)
+		std::vector<long long> actionWins; // per image action, times it's program had the followed bid
+	} profile;
+
+	// program ID -> fraction of updates in which the programs bid was followed
+	std::unordered_map<long, double> programWinFrequencies() const {
+		std::unordered_map<long, double> frequencies;
+		for (size_t a = 0; a < profile.actionWins.size(); a++) {
+			if (profile.actionWins[a] > 0) {
+				frequencies[image->actions[a].programID] += double(profile.actionWins[a]) / profile.updates;
+			}
+		}
+		return frequencies;
+	}
+#endif
+
 	TPGBrain() = delete;
 
 	// this costructor used only to generate progenitor it will
@@ -428,36 +904,55 @@ public:
 		// we will need to generate nodes and programs
 		
 		nrHidden = hiddenCountPL->get(PT);
+		bidCache.maxEntries = std::max(0, bidCacheSizePL->get(PT));
 		auto initalPrograms = initalProgramsPL->get(PT);
 		auto initalNodes = initalNodesPL->get(PT);
 
-		auto AllPrograms = std::make_shared<std::vector<std::shared_ptr<Program>>>();
-		auto AllNodes = std::make_shared<std::vector<std::shared_ptr<Node>>>();
+		graph = std::make_shared<Graph>(nrIn_, nrOut_, nrHidden);
+		if (selfTestPL->get(PT)) {
+			runSelfTest(*graph);
+		}
+
+		auto checkpointFileName = loadCheckpointPL->get(PT);
+		if (checkpointFileName != "") { // resume from a checkpoint saved by TPGOptimizer
+			std::ifstream checkpointFile(checkpointFileName, std::ios::binary);
+			if (!checkpointFile.is_open()) {
+				std::cout << "  in TPGBrain, could not open checkpoint file \"" << checkpointFileName << "\". exiting." << std::endl;
+				exit(1);
+			}
+			graph->loadCheckpoint(checkpointFile);
+			rootNode = graph->checkpointRoots[0];
+			buildImage();
+			std::cout << "  loaded TPG graph from checkpoint " << checkpointFileName << std::endl;
+			std::cout << "     total nodes: " << graph->nodes.size() << "  total programs : " << graph->programs.size() << "  root nodes : " << graph->checkpointRoots.size() << std::endl;
+			return;
+		}
 
 		// generate initial programs (these will be atomic)
 		for (int i = 0; i < initalPrograms; i++) {
-			auto newProgram = std::make_shared<Program>(nrIn_, nrOut_, nrHidden, AllNodes);
-			AllPrograms->push_back(newProgram);
+			graph->makeProgram();
 		}
 
 		// generate initial nodes
 		//for (int i = 0; i < initalNodes; i++) {
-			auto newNode = std::make_shared<Node>(AllPrograms);
-			// initalize with 2 programs
-			newNode->programs.push_back((*AllPrograms)[Random::getIndex(AllPrograms->size())]);
-			newNode->programs.back()->parentCount++;
-			newNode->programs.push_back((*AllPrograms)[Random::getIndex(AllPrograms->size())]);
-			newNode->programs.back()->parentCount++;
-			AllNodes->push_back(newNode);
+			// initalize with 2 programs. the progenitor is never in the population, so it's
+			// root is not pinned and is collected at the first cleanup.
+			rootNode = graph->makeNode({ graph->randomProgram(), graph->randomProgram() });
+			buildImage();
 		//}
 
-		(*AllNodes)[0]->allPrograms = AllPrograms;
-		(*AllPrograms)[0]->allNodes = AllNodes;
-		rootNode = (*AllNodes)[Random::getIndex((*AllNodes).size())];
 		std::cout << "  built a new projenitor TPG Brain." << std::endl;
-		std::cout << "     total nodes: " << (*(*rootNode->allPrograms)[0]->allNodes).size() << "  total programs : " << (*rootNode->allPrograms).size() << std::endl;
+		std::cout << "     total nodes: " << graph->nodes.size() << "  total programs : " << graph->programs.size() << std::endl;
+#ifdef TPG_BENCHMARK
+		runBenchmark(*graph);
+#endif
 	}
 
+	static void runSelfTest(const Graph &graph); // exits if the interpreters disagree, see TPGBenchmark.h
+#ifdef TPG_BENCHMARK
+	static void runBenchmark(const Graph &graph); // see TPGBenchmark.h
+#endif
+
 	TPGBrain(int nrIn_, int nrOut_, int nrHidden_,
 		std::shared_ptr<ParametersTable> PT_)
 		: AbstractBrain(nrIn_, nrOut_, PT_) {
@@ -472,37 +967,13 @@ public:
 	}
 
 	TPGBrain(int nrIn_, int nrOut_, int nrHidden_,
-		std::shared_ptr<Node> rootNode_,
-		std::shared_ptr<ParametersTable> PT_)
-		: AbstractBrain(nrIn_, nrOut_, PT_) {
-
-		// this constructor is used to generate the first population only
-		// it makes new nodes.
-
-		//rootNode = (*(*rootNode_->allPrograms)[0]->allNodes)[(*(*rootNode_->allPrograms)[0]->allNodes).size()];
-
-		rootNode = std::make_shared<Node>(rootNode_->allPrograms);
-		// initalize with 2 programs
-		rootNode->programs.push_back((*rootNode_->allPrograms)[Random::getIndex((*rootNode_->allPrograms).size())]);
-		rootNode->programs.back()->parentCount++;
-		rootNode->programs.push_back((*rootNode_->allPrograms)[Random::getIndex((*rootNode_->allPrograms).size())]);
-		rootNode->programs.back()->parentCount++;
-		(*(*rootNode_->allPrograms)[0]->allNodes).push_back(rootNode);
-
-		nrHidden = nrHidden_;
-		hiddenValues.resize(nrHidden);
-	}
-
-	TPGBrain(int nrIn_, int nrOut_, int nrHidden_,
-		std::shared_ptr<Node> rootNode_,
-		int pID,
+		std::shared_ptr<Graph> graph_,
+		NodeHandle rootNode_,
 		std::shared_ptr<ParametersTable> PT_)
-		: AbstractBrain(nrIn_, nrOut_, PT_) {
-
-		//rootNode = (*(*rootNode_->allPrograms)[0]->allNodes)[(*(*rootNode_->allPrograms)[0]->allNodes).size()];
+		: AbstractBrain(nrIn_, nrOut_, PT_), graph(graph_) {
 
 		rootNode = rootNode_;
-		// initalize with 2 programs
+		buildImage();
 		nrHidden = nrHidden_;
 		hiddenValues.resize(nrHidden);
 	}
@@ -513,6 +984,18 @@ public:
 		std::fill(hiddenValues.begin(), hiddenValues.end(), 0);
 	}
 
+	// reuse this brain (and it's scratch space) for another root node in the same graph
+	void setRootNode(NodeHandle rootNode_) {
+		rootNode = rootNode_;
+		buildImage();
+		bidCacheHits = 0;
+		bidCacheMisses = 0;
+#ifdef TPG_PROFILE
+		profile = Profile();
+#endif
+		resetBrain();
+	}
+
   virtual ~TPGBrain() = default;
 
   virtual void update() override;
@@ -528,6 +1011,23 @@ public:
   virtual std::string description() override { return "TPGBrain\n"; }
   virtual DataMap getStats(std::string &prefix) override {
 	  DataMap dataMap;
+	  dataMap.set(prefix + "TPG_scratchGrowths", scratchGrowths);
+	  if (bidCache.enabled()) {
+		  dataMap.set(prefix + "TPG_bidCacheHits", bidCacheHits);
+		  dataMap.set(prefix + "TPG_bidCacheMisses", bidCacheMisses);
+	  }
+#ifdef TPG_PROFILE
+	  double updates = std::max(1LL, profile.updates);
+	  dataMap.set(prefix + "TPG_nodesVisited", profile.nodesVisited / updates);
+	  dataMap.set(prefix + "TPG_avgDepth", profile.steps / updates);
+	  dataMap.set(prefix + "TPG_revisits", profile.revisits / updates);
+	  dataMap.set(prefix + "TPG_programEvals", profile.programEvals / updates);
+	  double topWinFrequency = 0;
+	  for (auto const & program : programWinFrequencies()) {
+		  topWinFrequency = std::max(topWinFrequency, program.second);
+	  }
+	  dataMap.set(prefix + "TPG_topProgramWinFrequency", topWinFrequency);
+#endif
 	  return dataMap;
   }
   virtual std::string getType() override { return "TPG"; }
@@ -536,15 +1036,14 @@ public:
 
   void initializeGenomes(
 	  std::unordered_map<std::string,
-	  std::shared_ptr<AbstractGenome>> &_genomes) {
+	  std::shared_ptr<AbstractGenome>> & /*_genomes*/) {
 	  // no genomes used here
   }
 
 
-  void DetectParts(const std::shared_ptr<Node> &n, 
-	  std::set<std::shared_ptr<Node>> &saveNodes,
-	  std::set<std::shared_ptr <Program>> &savePrograms,
-	  std::set<std::string> &visitedElements);
+  void DetectParts(NodeHandle nh,
+	  std::set<NodeHandle> &saveNodes,
+	  std::set<ProgramHandle> &savePrograms);
 
   // convert a brain into data map with data that can be saved to file
   virtual DataMap serialize(std::string &name) override;
@@ -0,0 +1,163 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include "TPGBrain.h"
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+// writes TPG graphs (or the part of a graph reachable from some root nodes) to files.
+// snapshot() copies the edges of the graph into a flat list (IDs only) and the bits of the
+// atomic actions they use, so the graph can be changed while the list is written (e.g. on
+// another thread).
+// the list can be written as DOT (each vertex is declared once, atomic actions are named by
+// their output and hidden bits, A<outputs>h<hidden>, and shared by all programs with the same
+// action) or as a binary edge list:
+//   uint32 magic ("TPGE"), uint32 version,
+//   uint32 atomic count, then per atomic action: int64 index, uint32 length, length chars
+//     (the bits as outputs|hidden, see Graph::atomicString),
+//   then one record per edge: uint8 type, int64 from, int64 to
+//   (host byte order, little endian on x86)
+// atomic indexes are only valid within one file (compact() renumbers the atomic table).
+// stable/pythonTools/tpgEdgesToDot.py converts an edge list to DOT.
+class TPGGraphWriter {
+public:
+	static const uint32_t edgeListMagic = 0x45475054; // "TPGE"
+	static const uint32_t edgeListVersion = 3;
+
+	enum EdgeType : uint8_t {
+		nodeToProgram = 0, // from node ID to program ID
+		programToNode = 1, // from program ID to node ID
+		programToAtomic = 2 // from program ID to atomic action index
+	};
+
+	struct Edge {
+		EdgeType type;
+		long long from;
+		long long to;
+	};
+
+	struct Snapshot {
+		std::vector<Edge> edges;
+		std::vector<std::pair<long long, std::string>> atomics; // atomic action index and bits
+	};
+
+	// edges of every node and program in graph (if roots is empty), or of the nodes and programs
+	// reachable from roots.
+	static Snapshot snapshot(const TPGBrain::Graph &graph, const std::vector<TPGBrain::NodeHandle> &roots) {
+		Snapshot result;
+		auto & edges = result.edges;
+		std::unordered_set<int> seenAtomics;
+		auto addProgram = [&](const TPGBrain::Program &p) {
+			if (p.actionType == 0) {
+				edges.push_back({ programToAtomic, p.ID, p.atomicAction });
+				if (seenAtomics.insert(p.atomicAction).second) {
+					result.atomics.push_back({ p.atomicAction, graph.atomicString(p.atomicAction) });
+				}
+			}
+			else {
+				edges.push_back({ programToNode, p.ID, graph.nodes[p.targetNode].ID });
+			}
+		};
+		if (roots.empty()) {
+			for (auto nh : graph.nodes.live) {
+				auto const & n = graph.nodes[nh];
+				for (auto ph : n.programs) {
+					edges.push_back({ nodeToProgram, n.ID, graph.programs[ph].ID });
+				}
+			}
+			for (auto ph : graph.programs.live) {
+				addProgram(graph.programs[ph]);
+			}
+			return result;
+		}
+		std::unordered_set<TPGBrain::NodeHandle> seenNodes(roots.begin(), roots.end());
+		std::unordered_set<TPGBrain::ProgramHandle> seenPrograms;
+		std::vector<TPGBrain::NodeHandle> toVisit(seenNodes.begin(), seenNodes.end());
+		while (!toVisit.empty()) {
+			auto const & n = graph.nodes[toVisit.back()];
+			toVisit.pop_back();
+			for (auto ph : n.programs) {
+				auto const & p = graph.programs[ph];
+				edges.push_back({ nodeToProgram, n.ID, p.ID });
+				if (seenPrograms.insert(ph).second) {
+					addProgram(p);
+					if (p.actionType == 1 && seenNodes.insert(p.targetNode).second) {
+						toVisit.push_back(p.targetNode);
+					}
+				}
+			}
+		}
+		return result;
+	}
+
+	static void writeDot(const Snapshot &snapshot, std::ostream &out) {
+		std::unordered_map<long long, const std::string *> atomicBits;
+		for (auto const & atomic : snapshot.atomics) {
+			atomicBits[atomic.first] = &atomic.second;
+		}
+		std::unordered_set<long long> seenNodes, seenPrograms, seenAtomics;
+		out << "digraph graphname {\n";
+		for (auto const & e : snapshot.edges) {
+			if (e.type == nodeToProgram) {
+				if (seenNodes.insert(e.from).second) {
+					out << "N" << e.from << " [color=yellow,shape=ellipse,style=filled]\n";
+				}
+				out << "  N" << e.from << " -> P" << e.to << "\n";
+				continue;
+			}
+			if (seenPrograms.insert(e.from).second) {
+				out << "P" << e.from << " [color=springGreen,shape=ellipse,style=filled]\n";
+			}
+			if (e.type == programToNode) {
+				out << "  P" << e.from << " -> N" << e.to << "\n";
+			}
+			else {
+				auto const & bits = *atomicBits[e.to];
+				auto name = "A" + bits;
+				name[name.find('|')] = 'h';
+				if (seenAtomics.insert(e.to).second) {
+					out << name << " [color=lightgrey,shape=component,style=filled,label=\"" << bits << "\"]\n";
+				}
+				out << "  P" << e.from << " -> " << name << "\n";
+			}
+		}
+		out << "}\n";
+	}
+
+	static void writeEdgeList(const Snapshot &snapshot, std::ostream &out) {
+		writeValue(out, (uint32_t)edgeListMagic);
+		writeValue(out, (uint32_t)edgeListVersion);
+		writeValue(out, (uint32_t)snapshot.atomics.size());
+		for (auto const & atomic : snapshot.atomics) {
+			writeValue(out, (int64_t)atomic.first);
+			writeValue(out, (uint32_t)atomic.second.size());
+			out.write(atomic.second.data(), atomic.second.size());
+		}
+		for (auto const & e : snapshot.edges) {
+			writeValue(out, (uint8_t)e.type);
+			writeValue(out, (int64_t)e.from);
+			writeValue(out, (int64_t)e.to);
+		}
+	}
+
+private:
+	template <class T>
+	static void writeValue(std::ostream &out, const T &value) {
+		out.write(reinterpret_cast<const char *>(&value), sizeof(T));
+	}
+};
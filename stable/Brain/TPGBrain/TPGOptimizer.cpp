@@ -20,9 +20,28 @@ Parameters::register_parameter("OPTIMIZER_TPG-newNodesTarget",
 std::shared_ptr<ParameterLink<int>> TPGOptimizer::maxNodesAllowedPL =
 Parameters::register_parameter("OPTIMIZER_TPG-maxNodesAllowed",
 	500, "maximum number of nodes allowed at any time (root and non-root)");
+std::shared_ptr<ParameterLink<int>> TPGOptimizer::offspringThreadsPL =
+Parameters::register_parameter("OPTIMIZER_TPG-offspringThreads",
+	1, "number of threads used to make mutated offspring nodes. results are the same for any number of threads");
+std::shared_ptr<ParameterLink<std::string>> TPGOptimizer::selectionMethodPL =
+Parameters::register_parameter("OPTIMIZER_TPG-selectionMethod",
+	(std::string) "rank", "how parents are picked from the ranked root nodes:\n"
+	"  rank - rank order index is pow(random[0,1),1.5) * population size\n"
+	"  tournament - best of tournamentSize random orgs\n"
+	"  truncation - random org from the best truncationFraction of the population\n"
+	"  lexicase - lexicase selection on lexicaseFormulas");
+std::shared_ptr<ParameterLink<int>> TPGOptimizer::tournamentSizePL =
+Parameters::register_parameter("OPTIMIZER_TPG-tournamentSize",
+	5, "number of orgs in each tournament (if selectionMethod is tournament)");
+std::shared_ptr<ParameterLink<double>> TPGOptimizer::truncationFractionPL =
+Parameters::register_parameter("OPTIMIZER_TPG-truncationFraction",
+	.2, "fraction of the population (best first) that parents are picked from (if selectionMethod is truncation)");
+std::shared_ptr<ParameterLink<std::string>> TPGOptimizer::lexicaseFormulasPL =
+Parameters::register_parameter("OPTIMIZER_TPG-lexicaseFormulas",
+	(std::string) "DM_AVE[score]", "space separated list of values (MTree) used as cases by lexicase selection (if selectionMethod is lexicase)");
 std::shared_ptr<ParameterLink<int>> TPGOptimizer::saveReportOnPL =
 Parameters::register_parameter("OPTIMIZER_TPG-saveReportOn",
-	1000, "a report with info on nodes and programs will be saved to output when update%saveReportOn == 0");
+	1000, "a report with info on nodes and programs will be saved to TPG_nodes_[update].csv and TPG_programs_[update].csv when update%saveReportOn == 0");
 std::shared_ptr<ParameterLink<int>> TPGOptimizer::saveFullGraphOnPL =
 Parameters::register_parameter("OPTIMIZER_TPG-saveFullGraphOn",
 	1000, "save a graph with all nodes, programs and, atomics when update%saveFullGraphOn == 0");
@@ -32,35 +51,119 @@ Parameters::register_parameter("OPTIMIZER_TPG-saveBestOn",
 std::shared_ptr<ParameterLink<int>> TPGOptimizer::saveBest3OnPL =
 Parameters::register_parameter("OPTIMIZER_TPG-saveBest3On",
 	1000, "save a graph of nodes,programs and, atomics associated with high score node when update%saveBest3On == 0");
+std::shared_ptr<ParameterLink<int>> TPGOptimizer::saveCheckpointOnPL =
+Parameters::register_parameter("OPTIMIZER_TPG-saveCheckpointOn",
+	0, "save a binary checkpoint of all nodes and programs and the new population (TPG_checkpoint_[update].bin) when update%saveCheckpointOn == 0.\n"
+	"load with BRAIN_TPG-loadCheckpoint to resume a run (0 = no checkpoints)");
+std::shared_ptr<ParameterLink<int>> TPGOptimizer::compactOnPL =
+Parameters::register_parameter("OPTIMIZER_TPG-compactOn",
+	0, "rebuild the graph with node and program IDs renumbered from 0 and unused memory released when update%compactOn == 0 (0 = never)");
+std::shared_ptr<ParameterLink<double>> TPGOptimizer::maxGraphMBPL =
+Parameters::register_parameter("OPTIMIZER_TPG-maxGraphMB",
+	0.0, "if the graph uses more than this many MB after offspring are made, root nodes with the lowest scoring parents are removed until it fits (0 = no limit)");
+std::shared_ptr<ParameterLink<std::string>> TPGOptimizer::graphFormatPL =
+Parameters::register_parameter("OPTIMIZER_TPG-graphFormat",
+	(std::string) "dot", "format of saved graphs:\n"
+	"  dot - graphviz file (.dot)\n"
+	"  edgeList - compact binary edge list (.edges), convert with pythonTools/tpgEdgesToDot.py");
+std::shared_ptr<ParameterLink<bool>> TPGOptimizer::saveInBackgroundPL =
+Parameters::register_parameter("OPTIMIZER_TPG-saveInBackground",
+	false, "if true, saved graphs and reports are written by a background thread while evolution continues");
+
+namespace {
+	// exit() (the archivist may end a run this way) does not destroy the optimizers, so files
+	// still being written on a background thread are waited for by an atexit handler.
+	std::mutex backgroundWritersMutex;
+	std::set<TPGOptimizer *> backgroundWriters;
+
+	void joinBackgroundWriters() {
+		std::lock_guard<std::mutex> lock(backgroundWritersMutex);
+		for (auto optimizer : backgroundWriters) {
+			if (optimizer->outputThread.joinable()) {
+				optimizer->outputThread.join();
+			}
+		}
+	}
+}
 
 TPGOptimizer::TPGOptimizer(std::shared_ptr<ParametersTable> PT_)
     : AbstractOptimizer(PT_) {
 
 	newNodesTarget = newNodesTargetPL->get(PT);
 	maxNodesAllowed = maxNodesAllowedPL->get(PT);
+	offspringThreads = std::max(1, offspringThreadsPL->get(PT));
 
 	saveReportOn = saveReportOnPL->get(PT);
 	saveFullGraphOn = saveFullGraphOnPL->get(PT);
 	saveBestOn = saveBestOnPL->get(PT);
 	saveBest3On = saveBest3OnPL->get(PT);
+	saveCheckpointOn = saveCheckpointOnPL->get(PT);
+	compactOn = compactOnPL->get(PT);
+	maxGraphMB = maxGraphMBPL->get(PT);
+	graphFormat = graphFormatPL->get(PT);
+	saveInBackground = saveInBackgroundPL->get(PT);
+	if (saveInBackground) {
+		static bool atexitSet = (std::atexit(joinBackgroundWriters) == 0);
+		(void)atexitSet;
+		std::lock_guard<std::mutex> lock(backgroundWritersMutex);
+		backgroundWriters.insert(this);
+	}
+	if (graphFormat != "dot" && graphFormat != "edgeList") {
+		std::cout << "  in TPGOptimizer, unknown graphFormat \"" << graphFormat << "\" (must be dot or edgeList). exiting." << std::endl;
+		exit(1);
+	}
 
 	optimizeValueMT = stringToMTree(optimizeValuePL->get(PT));
 	optimizeFormula = optimizeValueMT;
 
+	selectionMethod = selectionMethodPL->get(PT);
+	tournamentSize = std::max(1, tournamentSizePL->get(PT));
+	truncationFraction = truncationFractionPL->get(PT);
+	if (selectionMethod == "lexicase") {
+		std::stringstream formulas(lexicaseFormulasPL->get(PT));
+		std::string formula;
+		while (formulas >> formula) {
+			lexicaseMTs.push_back(stringToMTree(formula));
+		}
+		if (lexicaseMTs.empty()) {
+			std::cout << "  in TPGOptimizer, selectionMethod is lexicase but lexicaseFormulas is empty. exiting." << std::endl;
+			exit(1);
+		}
+	}
+	else if (selectionMethod != "rank" && selectionMethod != "tournament" && selectionMethod != "truncation") {
+		std::cout << "  in TPGOptimizer, unknown selectionMethod \"" << selectionMethod << "\" (must be rank, tournament, truncation or lexicase). exiting." << std::endl;
+		exit(1);
+	}
+
 	popFileColumns.clear();
 	popFileColumns.push_back("optimizeValue");
 }
 
+TPGOptimizer::~TPGOptimizer() {
+	std::lock_guard<std::mutex> lock(backgroundWritersMutex);
+	backgroundWriters.erase(this);
+	if (outputThread.joinable()) {
+		outputThread.join();
+	}
+}
+
 void TPGOptimizer::optimize(std::vector<std::shared_ptr<Organism>> &population) {
 	aveScore = 0;
 	orgScores.clear();
+	orgTaskScores.clear();
 	maxScore = optimizeValueMT->eval(population[0]->dataMap, PT)[0];
 	for (size_t i = 0; i < population.size(); i++) {
 
 
 		double opVal = optimizeValueMT->eval(population[i]->dataMap, PT)[0];
 		population[i]->dataMap.set("optimizeValue", opVal);
-		orgScores.push_back({ i, opVal });
+		orgScores.push_back(opVal);
+		if (!lexicaseMTs.empty()) {
+			orgTaskScores.emplace_back();
+			for (auto const & mt : lexicaseMTs) {
+				orgTaskScores.back().push_back(mt->eval(population[i]->dataMap, PT)[0]);
+			}
+		}
 		aveScore += opVal;
 		maxScore = std::max(maxScore, opVal);
 		//std::cout << i << ": " << opVal << std::endl;
@@ -70,174 +173,444 @@ void TPGOptimizer::optimize(std::vector<std::shared_ptr<Organism>> &population)
 	// we will do all the rest of the work work in cleanup
 }
 
-void saveSomeNodes(std::vector<std::shared_ptr<Organism>> orgs, std::vector<int> rankOrder, std::string graphFileName) {
-	std::string graphEdges;
-	std::string graphProps;
-	std::set<std::string> visitedElements;
-	graphEdges = "digraph graphname {\n";
-	for (auto org : orgs) {
-		auto b = std::dynamic_pointer_cast<TPGBrain>(org->brains["root::"]);
-		auto n = b->rootNode;
-		b->graphTPG(n, visitedElements, graphEdges, graphProps);
-	}
-	graphProps += "}\n";
-
-	//std::string graphFileName = "best_NaP_" + std::to_string(Global::update) + ".dot";
-	FileManager::writeToFile(graphFileName, graphEdges);
-	FileManager::writeToFile(graphFileName, graphProps);
+int TPGOptimizer::selectParent(const std::vector<int> &rankOrder) {
+	int popSize = (int)rankOrder.size();
+	if (selectionMethod == "tournament") {
+		int winner = Random::getIndex(popSize);
+		for (int i = 1; i < tournamentSize; i++) {
+			int challenger = Random::getIndex(popSize);
+			if (orgScores[challenger] > orgScores[winner]) {
+				winner = challenger;
+			}
+		}
+		return winner;
+	}
+	if (selectionMethod == "truncation") {
+		int poolSize = std::min(popSize, std::max(1, (int)std::ceil(truncationFraction * popSize)));
+		return rankOrder[Random::getIndex(poolSize)];
+	}
+	if (selectionMethod == "lexicase") {
+		// cases in random order, keep only the orgs that are best on each case
+		std::vector<int> candidates(popSize);
+		for (int i = 0; i < popSize; i++) {
+			candidates[i] = i;
+		}
+		std::vector<int> cases(lexicaseMTs.size());
+		for (size_t i = 0; i < cases.size(); i++) {
+			cases[i] = (int)i;
+		}
+		for (size_t i = 0; i < cases.size() && candidates.size() > 1; i++) {
+			std::swap(cases[i], cases[i + Random::getIndex(cases.size() - i)]);
+			double best = orgTaskScores[candidates[0]][cases[i]];
+			for (auto c : candidates) {
+				best = std::max(best, orgTaskScores[c][cases[i]]);
+			}
+			candidates.erase(std::remove_if(candidates.begin(), candidates.end(),
+				[&](int c) { return orgTaskScores[c][cases[i]] < best; }), candidates.end());
+		}
+		return candidates[Random::getIndex(candidates.size())];
+	}
+	// rank
+	return rankOrder[(int)(std::pow(Random::getDouble(1.0), 1.5) * popSize)];
+}
+
+// output files are written through a 1 MB buffer, which must be destroyed after out
+static void openOutputFile(std::ofstream &out, std::vector<char> &buffer, const std::string &fileName) {
+	buffer.resize(1 << 20);
+	out.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+	out.open(FileManager::outputPrefix + fileName, std::ios::binary);
 }
 
-void saveAllNodesAndPrograms(
-	std::shared_ptr<std::vector<std::shared_ptr<TPGBrain::Node>>> allNodes,
-	std::shared_ptr<std::vector<std::shared_ptr<TPGBrain::Program>>> allPrograms,
-	std::string graphFileName) {
-	std::string graphEdges;
-	std::string graphProps;
-	graphEdges = "digraph graphname {\n";
-	for (auto n : (*allNodes)) {
-		graphProps += "N" + std::to_string(n->ID) + " [color=yellow,shape=ellipse,style=filled]\n";
-		for (auto p : n->programs) {
-			graphEdges += "  N" + std::to_string(n->ID) + " -> P" + std::to_string(p->ID) + "\n";
-		}
-	}
-	for (auto p : (*allPrograms)) {
-		graphProps += "P" + std::to_string(p->ID) + " [color=springGreen,shape=ellipse,style=filled]\n";
-		if (p->actionType == 0) {
-			graphProps += "A" + std::to_string(p->targetAtomic) + "h" + std::to_string(p->targetHidden) + " [color=lightgrey,shape=component,style=filled]\n";
-			graphEdges += "  P" + std::to_string(p->ID) + " -> A" + std::to_string(p->targetAtomic) + "h" + std::to_string(p->targetHidden) + "\n";
+void TPGOptimizer::saveGraph(const std::string &fileName, TPGGraphWriter::Snapshot snapshot) {
+	bool edgeList = graphFormat == "edgeList";
+	outputJobs.push_back([fileName, snapshot, edgeList]() {
+		std::vector<char> buffer; // declared first, out flushes into it when it is destroyed
+		std::ofstream out;
+		openOutputFile(out, buffer, fileName + (edgeList ? ".edges" : ".dot"));
+		if (edgeList) {
+			TPGGraphWriter::writeEdgeList(snapshot, out);
 		}
 		else {
-			graphEdges += "  P" + std::to_string(p->ID) + " -> N" + std::to_string(p->targetNode->ID) + "\n";
+			TPGGraphWriter::writeDot(snapshot, out);
 		}
+	});
+}
+
+void TPGOptimizer::saveReport(const TPGBrain::Graph &graph) {
+	// copy what is needed from the graph, the files may be written after the graph changes
+	struct NodeRow {
+		long ID;
+		int parentCount;
+		std::vector<long> programIDs;
+	};
+	struct ProgramRow {
+		long ID;
+		int parentCount;
+		int effectiveLength;
+		int actionType;
+		long long target; // node ID or atomic action index
+		std::string atomicBits; // outputs|hidden of the atomic action
+	};
+	std::vector<NodeRow> nodeRows;
+	std::vector<ProgramRow> programRows;
+	for (auto nh : graph.nodes.live) {
+		auto const & n = graph.nodes[nh];
+		nodeRows.push_back({ n.ID, n.parentCount, {} });
+		for (auto ph : n.programs) {
+			nodeRows.back().programIDs.push_back(graph.programs[ph].ID);
+		}
+	}
+	for (auto ph : graph.programs.live) {
+		auto const & p = graph.programs[ph];
+		programRows.push_back({ p.ID, p.parentCount, p.effectiveLength(), p.actionType,
+			(p.actionType == 0) ? p.atomicAction : graph.nodes[p.targetNode].ID, (p.actionType == 0) ? graph.atomicString(p.atomicAction) : "" });
 	}
-	graphProps += "}\n";
-	FileManager::writeToFile(graphFileName, graphEdges);
-	FileManager::writeToFile(graphFileName, graphProps);
+	auto update = std::to_string(Global::update);
+	outputJobs.push_back([update, nodeRows, programRows]() {
+		std::vector<char> buffer;
+		{
+			std::ofstream out;
+			openOutputFile(out, buffer, "TPG_nodes_" + update + ".csv");
+			out << "nodeID,programCount,parentCount,programIDs\n";
+			for (auto const & row : nodeRows) {
+				out << row.ID << "," << row.programIDs.size() << "," << row.parentCount << ",\"";
+				for (size_t i = 0; i < row.programIDs.size(); i++) {
+					out << ((i > 0) ? " " : "") << row.programIDs[i];
+				}
+				out << "\"\n";
+			}
+		}
+		std::ofstream out;
+		openOutputFile(out, buffer, "TPG_programs_" + update + ".csv");
+		out << "programID,parentCount,effectiveLength,actionType,target,atomicBits\n";
+		for (auto const & row : programRows) {
+			out << row.ID << "," << row.parentCount << "," << row.effectiveLength << "," << row.actionType << "," << row.target << "," << row.atomicBits << "\n";
+		}
+	});
+}
+
+void TPGOptimizer::writeOutput() {
+	// only one batch of files is written at a time
+	if (outputThread.joinable()) {
+		outputThread.join();
+	}
+	if (outputJobs.empty()) {
+		return;
+	}
+	auto runJobs = [](const std::vector<std::function<void()>> &jobs) {
+		for (auto const & job : jobs) {
+			job();
+		}
+	};
+	// nothing runs after the cleanup of the last update, so those files are written before
+	// cleanup returns
+	if (saveInBackground && Global::update < Global::updatesPL->get()) {
+		outputThread = std::thread(runJobs, std::move(outputJobs));
+	}
+	else {
+		runJobs(outputJobs);
+	}
+	outputJobs.clear();
 }
 
 void TPGOptimizer::cleanup(std::vector<std::shared_ptr<Organism>> &population) {
 	std::vector<std::shared_ptr<Organism>> newPopulation;
+	std::vector<TPGBrain::NodeHandle> newRoots;
 	
 	
 	// dynamicly cast org 0s brain, and get
 	auto exampleBrain = std::dynamic_pointer_cast<TPGBrain>(population[0]->brains["root::"]);
-	if (exampleBrain->rootNode == nullptr) { // if eampleBrain is nullptr there was an error in setup.
-		std::cout << "in TPG Optimizer, example brain is nullptr. This is bad." << std::endl;
+	if (exampleBrain->graph == nullptr) { // if eampleBrain has no graph there was an error in setup.
+		std::cout << "in TPG Optimizer, example brain has no graph. This is bad." << std::endl;
 		std::exit(1);
 	}
-	// get allNodes and allProgrms
-	auto allPrograms = exampleBrain->rootNode->allPrograms;
-	auto allNodes = exampleBrain->rootNode->programs[0]->allNodes;
-
+	// get the graph with all nodes and programs
+	auto & graph = *exampleBrain->graph;
 
-	// get rank order for all orgs (with a really terrible algorithom)
-	std::vector<int> rankOrder;
-	for (size_t i = 0; i < population.size(); i++) {
-		double currMaxScore = orgScores[0].second;
-		size_t maxScoreIndex = 0;
-		for (size_t j = 1; j < orgScores.size(); j++) { 
-			if (orgScores[j].second > currMaxScore) {
-				currMaxScore = orgScores[j].second;
-				maxScoreIndex = j;
-			}
+#ifdef TPG_PROFILE
+	// the programs that had the followed bid most often (per update, averaged over the population)
+	std::unordered_map<long, double> programWins;
+	for (auto const & org : population) {
+		for (auto const & program : std::dynamic_pointer_cast<TPGBrain>(org->brains["root::"])->programWinFrequencies()) {
+			programWins[program.first] += program.second / population.size();
 		}
-		rankOrder.push_back(orgScores[maxScoreIndex].first);
-		orgScores[maxScoreIndex] = orgScores.back();
-		orgScores.pop_back();
 	}
+	std::vector<std::pair<long, double>> topPrograms(programWins.begin(), programWins.end());
+	auto topCount = std::min(topPrograms.size(), (size_t)5);
+	std::partial_sort(topPrograms.begin(), topPrograms.begin() + topCount, topPrograms.end(),
+		[](const std::pair<long, double> &a, const std::pair<long, double> &b) { return a.second > b.second || (a.second == b.second && a.first < b.first); });
+	topPrograms.resize(topCount);
+#endif
+
+
+	// get rank order for all orgs (best first, ties in population order)
+	std::vector<int> rankOrder(population.size());
+	for (size_t i = 0; i < rankOrder.size(); i++) {
+		rankOrder[i] = (int)i;
+	}
+	std::stable_sort(rankOrder.begin(), rankOrder.end(), [this](int a, int b) { return orgScores[a] > orgScores[b]; });
 
-	// see if we need to save any graphs.
+	// see if we need to save any graphs. the edges (and atomic actions) are copied now, the files are written
+	// at the end of cleanup (see writeOutput).
+	auto rootOf = [&population, &rankOrder](int rank) {
+		return std::dynamic_pointer_cast<TPGBrain>(population[rankOrder[rank]]->brains["root::"])->rootNode;
+	};
 	if (Global::update % saveBestOn == 0) {  // save graph of best rootNode
-		auto orgs = { population[rankOrder[0]] };
-		saveSomeNodes(orgs, rankOrder, "best_NaP_" + std::to_string(Global::update) + ".dot");
+		saveGraph("best_NaP_" + std::to_string(Global::update), TPGGraphWriter::snapshot(graph, { rootOf(0) }));
 	}
 	if (Global::update % saveBest3On == 0) {  // save graph of best 3 rootNodes
-		auto orgs = { population[rankOrder[0]] , population[rankOrder[1]]  , population[rankOrder[2]] };
-		saveSomeNodes(orgs, rankOrder, "best3_NaP_" + std::to_string(Global::update) + ".dot");
+		saveGraph("best3_NaP_" + std::to_string(Global::update), TPGGraphWriter::snapshot(graph, { rootOf(0), rootOf(1), rootOf(2) }));
 	}
 	if (Global::update % saveFullGraphOn == 0) {  // save graph of all nodes and programs
-		saveAllNodesAndPrograms(allNodes, allPrograms, "All_NaP_" + std::to_string(Global::update) + ".dot");
+		saveGraph("All_NaP_" + std::to_string(Global::update), TPGGraphWriter::snapshot(graph, {}));
 	}
 
 	int newNodesCount = 0;
 
-	// remove all root nodes from allNodes. some will be put back (and cloned/mutated)
-	for (size_t i = 0; i < (*allNodes).size(); ) {
-		auto node = (*allNodes)[i];
-		if (node->parentCount == 0) {// this is a root node
-			for (auto p : node->programs) {
-				//std::cout << " " << n->ID << ":" << p->ID << ":" << p->parentCount << "   ->   ";
-				p->parentCount--;
-				//std::cout << " " << n->ID << ":" << p->ID << ":" << p->parentCount << std::endl;
-			}
-			(*allNodes)[i] = (*allNodes).back();
-			(*allNodes).pop_back();
-		}
-		else { // if not a root node, advance to next node in allNodes
-			i++;
+	// the brain of each org. several orgs may share a root node, the first org with a root
+	// node is it's owner.
+	// a brain can only be reused if nothing outside of the population holds its org or the
+	// brain (an archivist, another org...). the brain is then held by its org, by brains and,
+	// for org 0, by exampleBrain.
+	std::vector<std::shared_ptr<TPGBrain>> brains;
+	std::vector<bool> reusable;
+	std::unordered_map<TPGBrain::NodeHandle, int> rootOwner;
+	int removableRoots = 0; // root nodes that leave the graph if no parent keeps them
+	for (size_t i = 0; i < population.size(); i++) {
+		brains.push_back(std::dynamic_pointer_cast<TPGBrain>(population[i]->brains["root::"]));
+		reusable.push_back(population[i].use_count() == 1 && brains[i].use_count() == (brains[i] == exampleBrain ? 3 : 2));
+		if (rootOwner.emplace(brains[i]->rootNode, (int)i).second && graph.nodes[brains[i]->rootNode].parentCount == 0) {
+			removableRoots++;
 		}
 	}
 
 	// now we will use ranked orgs in population to get parents. for each parent, clone and then clone and mutate each 
-	while (newNodesCount < newNodesTarget && (*allNodes).size() < maxNodesAllowed) {
-		// get a brain
-		auto subjectBrain = std::dynamic_pointer_cast<TPGBrain>(population[rankOrder[(int)(std::pow(Random::getDouble(1.0), 1.5) * rankOrder.size())]]->brains["root::"]);
-		// add this brains node and a mutated clone to allNodes
-		(*allNodes).push_back(subjectBrain->rootNode->clone());
-		newNodesCount++;
-		(*allNodes).push_back(subjectBrain->rootNode->cloneAndMutate());
-		newNodesCount++;
-	}
-
-	// delete unused programs
-	int programsDeleted = 0;
-	for (size_t i = 0; i < (*allPrograms).size();) {
-		if ((*allPrograms)[i]->parentCount == 0) { // noone is using this program, we can delete it.
-			if ((*allPrograms)[i]->actionType == 1) {
-				(*allPrograms)[i]->targetNode->parentCount--;
+	// each pair adds two nodes to the graph, so the number of pairs is known before any are made.
+	int pairCount = 0;
+	while (newNodesCount < newNodesTarget && (int)graph.nodes.size() - removableRoots + 2 * pairCount < maxNodesAllowed) {
+		pairCount++;
+		newNodesCount += 2;
+	}
+	std::vector<int> parents;
+	for (int i = 0; i < pairCount; i++) {
+		parents.push_back(selectParent(rankOrder));
+	}
+
+	// the first time a parent is picked, it's root node is kept as the unmutated offspring (so
+	// it's org and brain carry over to the new population). later picks add a copy of the node.
+	std::vector<TPGBrain::NodeHandle> offspring(2 * pairCount, tpgNullHandle); // pinned until the new population is made
+	std::vector<bool> rootKept(population.size(), false); // by owner
+	for (int i = 0; i < pairCount; i++) {
+		int owner = rootOwner[brains[parents[i]]->rootNode];
+		if (!rootKept[owner]) {
+			rootKept[owner] = true;
+			offspring[2 * i] = brains[owner]->rootNode;
+		}
+	}
+
+	// remove the other root nodes from the graph. root nodes that programs point at stay in
+	// the graph, but are no longer pinned. this is done in population order so the order of
+	// the graphs live lists does not depend on handle values.
+	for (size_t i = 0; i < population.size(); i++) {
+		auto nh = brains[i]->rootNode;
+		if (rootOwner[nh] == (int)i && !rootKept[i]) {
+			graph.nodes[nh].pinned = false;
+			if (graph.nodes[nh].parentCount == 0) {// this is a root node
+				graph.eraseNode(nh);
 			}
-			(*allPrograms)[i] = (*allPrograms).back();
-			(*allPrograms).pop_back();
-			programsDeleted++;
 		}
-		else {
-			i++; // a node is pointing at this, so we need to keep it.
+	}
+
+	// add a copy of the parents node for the later picks
+	for (int i = 0; i < pairCount; i++) {
+		auto parentNode = brains[parents[i]]->rootNode;
+		if (offspring[2 * i] != parentNode) {
+			offspring[2 * i] = graph.makeNode(graph.nodes[parentNode].programs);
+			graph.nodes[offspring[2 * i]].pinned = true;
+		}
+	}
+
+	// make a mutated clone of each copy. staging only reads the graph, so this is split across
+	// threads. each clone has it's own generator seeded from baseSeed and it's index, so the
+	// results do not depend on the number of threads.
+	std::vector<TPGBrain::StagedNode> staged(pairCount);
+	auto baseSeed = Random::getCommonGenerator()();
+	auto stageOffspring = [&](int first, int step) {
+		for (int i = first; i < pairCount; i += step) {
+			std::seed_seq seeds{ (uint32_t)baseSeed, (uint32_t)i };
+			std::mt19937 generator(seeds);
+			staged[i] = graph.stageMutatedNode(graph.nodes[offspring[2 * i]].programs, generator);
+		}
+	};
+	int threadCount = std::min(offspringThreads, pairCount);
+	if (threadCount > 1) {
+		std::vector<std::thread> threads;
+		for (int t = 0; t < threadCount; t++) {
+			threads.push_back(std::thread(stageOffspring, t, threadCount));
 		}
+		for (auto & t : threads) {
+			t.join();
+		}
+	}
+	else {
+		stageOffspring(0, 1);
 	}
 
-	// make a new population from new root nodes
+	// add the clones to the graph, in order
+	for (int i = 0; i < pairCount; i++) {
+		offspring[2 * i + 1] = graph.commitStagedNode(staged[i]);
+		graph.nodes[offspring[2 * i + 1]].pinned = true;
+	}
+
+	// delete unused programs, and nodes that are no longer used by any program (and the
+	// programs only those nodes used...)
+	graph.collect();
+
+	// brains that did not keep their root node (or share it with their owner) can be reused
+	for (size_t i = 0; i < population.size(); i++) {
+		auto nh = brains[i]->rootNode;
+		if (reusable[i] && (rootOwner[nh] != (int)i || !rootKept[i] || graph.nodes[nh].parentCount > 0)) {
+			brains[i]->image.reset();
+			spareBrains.push_back(brains[i]);
+		}
+	}
+
+	// make a new population from new root nodes (a mutation may have pointed a program at a
+	// new node, it is then no longer a root node). every root node gets a new org (with a new
+	// ID and time of birth). kept root nodes keep their brain (if it is not shared), other root
+	// nodes get a spare brain if there is one, or a new brain.
 	int rootNodeCount = 0;
-	population.clear();
-	for (size_t i = 0; i < (*allNodes).size(); ) {
-		auto node = (*allNodes)[i];
-		if (node->parentCount == 0) {// this is a root node
+	std::vector<double> parentScores; // per org in the new population
+	for (size_t k = 0; k < offspring.size(); k++) {
+		auto nh = offspring[k];
+		if (graph.nodes[nh].parentCount == 0) {// this is a root node
+			std::shared_ptr<TPGBrain> newBrain;
+			auto owner = rootOwner.find(nh);
+			if (owner != rootOwner.end() && rootKept[owner->second] && reusable[owner->second]) {
+				newBrain = brains[owner->second];
+			}
+			else if (!spareBrains.empty()) {
+				newBrain = spareBrains.back();
+				spareBrains.pop_back();
+			}
+			if (newBrain != nullptr) {
+				newBrain->setRootNode(nh);
+			}
+			else {
+				newBrain = std::make_shared<TPGBrain>(exampleBrain->nrInputValues, exampleBrain->nrOutputValues, exampleBrain->nrHidden, exampleBrain->graph, nh, PT);
+			}
 			auto newOrg = std::make_shared<Organism>(PT);
-			newOrg->brains["root::"] = std::make_shared<TPGBrain>(exampleBrain->nrInputValues, exampleBrain->nrOutputValues, exampleBrain->nrHidden, node, 0, PT);
-			population.push_back(newOrg);
+			newOrg->brains["root::"] = newBrain;
+			newPopulation.push_back(newOrg);
+			newRoots.push_back(nh);
+			parentScores.push_back(orgScores[parents[k / 2]]);
 			rootNodeCount++;
 		}
-		i++;
+		else {
+			graph.nodes[nh].pinned = false;
+		}
 	}
+	population.swap(newPopulation);
 
-	if (Global::update % saveReportOn == 0) {
-		for (auto n : (*allNodes)) {
-			std::cout << "node: " << n->ID << " has " << n->programs.size() << " programs (";
-			for (auto p : n->programs) {
-				std::cout << p->ID << " ";
-			}
-			std::cout << ") and " << n->parentCount << " parents." << std::endl;
+	// enforce the memory ceiling by removing the root nodes (and orgs) with the lowest scoring
+	// parents, a tenth of the population at a time, until the graph fits.
+	int prunedTeams = 0;
+	if (maxGraphMB > 0 && graph.memoryUsage().used() > maxGraphMB * 1024 * 1024) {
+		std::vector<int> pruneOrder(population.size());
+		for (size_t i = 0; i < pruneOrder.size(); i++) {
+			pruneOrder[i] = (int)i;
 		}
-		for (auto p : (*allPrograms)) {
-			std::cout << "program: " << p->ID << " has " << p->parentCount << " parents. output is ";
-			if (p->actionType == 0) {
-				std::cout << "atomic: " << p->targetAtomic << " " << p->targetHidden << std::endl;
+		std::stable_sort(pruneOrder.begin(), pruneOrder.end(), [&parentScores](int a, int b) { return parentScores[a] < parentScores[b]; });
+		std::vector<bool> pruned(population.size(), false);
+		while (graph.memoryUsage().used() > maxGraphMB * 1024 * 1024 && population.size() - prunedTeams > 1) {
+			int batch = std::max(1, (int)(population.size() - prunedTeams) / 10);
+			for (int b = 0; b < batch && population.size() - prunedTeams > 1; b++) {
+				int k = pruneOrder[prunedTeams++];
+				pruned[k] = true;
+				graph.nodes[newRoots[k]].pinned = false;
+				graph.eraseNode(newRoots[k]);
+				// the org was made above and every brain in the new population is unshared
+				auto prunedBrain = std::dynamic_pointer_cast<TPGBrain>(population[k]->brains["root::"]);
+				prunedBrain->image.reset();
+				spareBrains.push_back(prunedBrain);
 			}
-			else {
-				std::cout << "node: " << p->targetNode->ID << std::endl;
+			graph.collect();
+		}
+		size_t kept = 0;
+		for (size_t k = 0; k < population.size(); k++) {
+			if (!pruned[k]) {
+				population[kept] = population[k];
+				newRoots[kept] = newRoots[k];
+				kept++;
 			}
 		}
+		population.resize(kept);
+		newRoots.resize(kept);
+		rootNodeCount = (int)kept;
+	}
+
+	// renumber IDs and release unused memory. every handle changes, so brains get their new root
+	if (compactOn > 0 && Global::update % compactOn == 0) {
+		graph.compact(newRoots);
+		for (size_t i = 0; i < population.size(); i++) {
+			std::dynamic_pointer_cast<TPGBrain>(population[i]->brains["root::"])->setRootNode(newRoots[i]);
+		}
+		for (auto const & brain : spareBrains) {
+			brain->rootNode = tpgNullHandle;
+		}
+	}
+
+	if (saveCheckpointOn > 0 && Global::update % saveCheckpointOn == 0) {
+		std::ofstream checkpointFile(FileManager::outputPrefix + "TPG_checkpoint_" + std::to_string(Global::update) + ".bin", std::ios::binary);
+		graph.saveCheckpoint(checkpointFile, newRoots);
+	}
+
+	if (Global::update % saveReportOn == 0) {
+		saveReport(graph);
+	}
+	writeOutput();
+
+	double aveEffectiveLength = 0;
+	for (auto ph : graph.programs.live) {
+		aveEffectiveLength += graph.programs[ph].effectiveLength();
+	}
+	aveEffectiveLength /= std::max((size_t)1, graph.programs.size());
+
+	// the summary is written to stdout with one flush
+	std::ostringstream summary;
+	summary << "\n    maxScore: " << maxScore << "    aveScore: " << aveScore << "\n";
+	summary << "    nodes: " << graph.nodes.size() << "   rootNodes: " << rootNodeCount << "   programs: " << graph.programs.size() << "   after " << graph.programsCollected << " programs and " << graph.nodesCollected << " nodes were collected.\n";
+	summary << "    program effective length (ave): " << aveEffectiveLength << " of " << graph.numInstructions << " instructions\n";
+	summary << "    duplicate programs merged: " << graph.programsDeduplicated << "\n";
+	auto memory = graph.memoryUsage();
+	summary << "    graph memory (KB): " << memory.used() / 1024 << " (nodes: " << memory.nodes / 1024 << "  programs: " << memory.programs / 1024 <<
+		"  instruction codes: " << memory.instructionCodes / 1024 << "  register presets: " << memory.registerPresets / 1024 <<
+		"  program index: " << memory.programIndex / 1024 << "  atomic actions: " << memory.atomics / 1024 << " (" << graph.atomicCount() << ")  team images: " << memory.teamImages / 1024 << ")  unused pool space: " << memory.poolSpace / 1024;
+	if (prunedTeams > 0) {
+		summary << "  root nodes pruned to fit maxGraphMB: " << prunedTeams;
+	}
+	summary << "\n";
+	graph.programsDeduplicated = 0;
+	graph.programsCollected = 0;
+	graph.nodesCollected = 0;
+#ifdef TPG_PROFILE
+	summary << "    most followed programs (ID:wins per update):";
+	for (auto const & program : topPrograms) {
+		summary << " " << program.first << ":" << program.second;
+	}
+	summary << "\n";
+#endif
+	if (TPGBrain::bidCache.enabled()) {
+		auto & bidCache = TPGBrain::bidCache;
+		auto lookups = bidCache.hits() + bidCache.misses();
+		summary << "    bid cache hits: " << bidCache.hits() << "   misses: " << bidCache.misses() << "   hit rate: " << ((lookups > 0) ? double(bidCache.hits()) / lookups : 0.0) << "   cached bids: " << bidCache.entries() << "\n";
+		summary << "    bid cache shards (hits/misses):";
+		for (auto const & shard : bidCache.shards) {
+			summary << " " << shard.hits << "/" << shard.misses;
+		}
+		summary << "\n";
+		bidCache.resetCounts();
 	}
-	std::cout << "\n    maxScore: " << maxScore << "    aveScore: " << aveScore << std::endl;
-	std::cout << "    nodes: " << (*allNodes).size() << "   rootNodes: " << rootNodeCount << "   programs: " << (*allPrograms).size() << "   after " << programsDeleted << " were deleted." << std::endl;
+	std::cout << summary.str() << std::flush;
 }
 
@@ -10,10 +10,17 @@
 
 #include "../AbstractOptimizer.h"
 #include "../../Brain/TPGBrain/TPGBrain.h"
+#include "../../Brain/TPGBrain/TPGGraphWriter.h"
 #include "../../Utilities/MTree.h"
 
+#include <algorithm>
+#include <fstream>
+#include <functional>
 #include <iostream>
+#include <mutex>
+#include <set>
 #include <sstream>
+#include <thread>
 
 class TPGOptimizer : public AbstractOptimizer {
 public:
@@ -23,31 +30,68 @@ public:
 	static std::shared_ptr<ParameterLink<int>> saveFullGraphOnPL;
 	static std::shared_ptr<ParameterLink<int>> saveBestOnPL;
 	static std::shared_ptr<ParameterLink<int>> saveBest3OnPL;
+	static std::shared_ptr<ParameterLink<int>> saveCheckpointOnPL;
+	static std::shared_ptr<ParameterLink<int>> compactOnPL;
+	static std::shared_ptr<ParameterLink<double>> maxGraphMBPL;
+	static std::shared_ptr<ParameterLink<std::string>> graphFormatPL;
+	static std::shared_ptr<ParameterLink<bool>> saveInBackgroundPL;
 	static std::shared_ptr<ParameterLink<int>> newNodesTargetPL;
 	static std::shared_ptr<ParameterLink<int>> maxNodesAllowedPL;
+	static std::shared_ptr<ParameterLink<int>> offspringThreadsPL;
+	static std::shared_ptr<ParameterLink<std::string>> selectionMethodPL;
+	static std::shared_ptr<ParameterLink<int>> tournamentSizePL;
+	static std::shared_ptr<ParameterLink<double>> truncationFractionPL;
+	static std::shared_ptr<ParameterLink<std::string>> lexicaseFormulasPL;
 
   std::shared_ptr<Abstract_MTree> optimizeValueMT;
+  std::vector<std::shared_ptr<Abstract_MTree>> lexicaseMTs;
 
 
   int newNodesTarget;
   int maxNodesAllowed;
+  int offspringThreads;
 
   int saveReportOn;
   int saveFullGraphOn;
   int saveBestOn;
   int saveBest3On;
+  int saveCheckpointOn;
+  int compactOn;
+  double maxGraphMB; // 0 = no limit
+  std::string graphFormat; // dot or edgeList
+  bool saveInBackground;
+  std::vector<std::function<void()>> outputJobs; // files to write at the end of cleanup
+  std::thread outputThread; // writing saved files, if saveInBackground
 
-  std::vector<std::pair<size_t, double>> orgScores;
+  std::string selectionMethod; // rank, tournament, truncation or lexicase
+  int tournamentSize;
+  double truncationFraction;
+
+  std::vector<std::shared_ptr<TPGBrain>> spareBrains; // brains (and their scratch space) that are reused for new root nodes
+
+  std::vector<double> orgScores; // optimizeValue of each org, set in optimize()
+  std::vector<std::vector<double>> orgTaskScores; // [org][lexicase formula], only for lexicase
   double aveScore;
   double maxScore;
 
   TPGOptimizer(std::shared_ptr<ParametersTable> PT_ = nullptr);
+  virtual ~TPGOptimizer();
 
   virtual void optimize(std::vector<std::shared_ptr<Organism>> &population) override;
 
 
   virtual void cleanup(std::vector<std::shared_ptr<Organism>> &population);
 
+  // index in population of a parent, rankOrder is population indexes sorted by orgScores (best first)
+  int selectParent(const std::vector<int> &rankOrder);
+
+  // add output jobs for a graph (file name without extension, snapshot written in graphFormat)
+  // and for the node and program report
+  void saveGraph(const std::string &fileName, TPGGraphWriter::Snapshot snapshot);
+  void saveReport(const TPGBrain::Graph &graph);
+  // write the files from outputJobs (on outputThread if saveInBackground)
+  void writeOutput();
+
   // virtual string maxValueName() override {
   //	return (PT == nullptr) ? optimizeValuePL->lookup() :
   //PT->lookupString("OPTIMIZER_Simple-optimizeValue");
@@ -0,0 +1,121 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+typedef uint32_t TPGHandle;
+static const TPGHandle tpgNullHandle = 0xFFFFFFFFu;
+
+// contiguous storage for TPG Nodes and Programs. Elements are addressed by 32 bit
+// handles (low 24 bits are the slot index, high 8 bits are the slot generation).
+// When an element is erased its slot generation is advanced so old handles to it
+// are no longer valid() and the slot is put on a free list to be reused.
+// live holds the handle of every element in the pool. erase swaps the last live
+// handle into the erased handles position (the same way allNodes and allPrograms
+// used to be managed) so live can be scanned with an index while erasing.
+template <class T>
+class TPGPool {
+public:
+	typedef TPGHandle Handle;
+	static const int indexBits = 24;
+	static const uint32_t indexMask = (1u << indexBits) - 1;
+
+	std::vector<T> slots;
+	std::vector<uint8_t> generations; // per slot
+	std::vector<uint32_t> livePositions; // per slot, position of slots handle in live
+	std::vector<uint32_t> freeSlots;
+	std::vector<Handle> live;
+
+	static uint32_t indexOf(Handle h) {
+		return h & indexMask;
+	}
+
+	bool valid(Handle h) const {
+		return h != tpgNullHandle && indexOf(h) < slots.size() && generations[indexOf(h)] == (h >> indexBits) &&
+			livePositions[indexOf(h)] < live.size() && live[livePositions[indexOf(h)]] == h;
+	}
+
+	T &operator[](Handle h) {
+		return slots[indexOf(h)];
+	}
+
+	const T &operator[](Handle h) const {
+		return slots[indexOf(h)];
+	}
+
+	size_t size() const {
+		return live.size();
+	}
+
+	Handle insert(T &&element) {
+		uint32_t index;
+		if (!freeSlots.empty()) {
+			index = freeSlots.back();
+			freeSlots.pop_back();
+			slots[index] = std::move(element);
+		}
+		else {
+			index = (uint32_t)slots.size();
+			if (index >= indexMask) { // the last index is kept free so no handle equals tpgNullHandle
+				std::cout << "  in TPGPool::insert, pool is full (" << indexMask + 1 << " elements). exiting." << std::endl;
+				exit(1);
+			}
+			slots.push_back(std::move(element));
+			generations.push_back(0);
+			livePositions.push_back(0);
+		}
+		Handle h = ((Handle)generations[index] << indexBits) | index;
+		livePositions[index] = (uint32_t)live.size();
+		live.push_back(h);
+		return h;
+	}
+
+	void erase(Handle h) {
+		uint32_t index = indexOf(h);
+		generations[index]++; // all handles to this slot are now stale
+		slots[index] = T(); // release memory held by the element
+		uint32_t position = livePositions[index];
+		live[position] = live.back();
+		livePositions[indexOf(live[position])] = position;
+		live.pop_back();
+		freeSlots.push_back(index);
+	}
+
+	// release unused capacity (slots of erased elements are kept, they are on freeSlots)
+	void shrinkToFit() {
+		slots.shrink_to_fit();
+		generations.shrink_to_fit();
+		livePositions.shrink_to_fit();
+		freeSlots.shrink_to_fit();
+		live.shrink_to_fit();
+	}
+
+	// bytes held by the pool itself (not by memory the elements own)
+	size_t capacityBytes() const {
+		return slots.capacity() * sizeof(T) + generations.capacity() * sizeof(uint8_t) +
+			(livePositions.capacity() + freeSlots.capacity()) * sizeof(uint32_t) + live.capacity() * sizeof(Handle);
+	}
+
+	void clear() {
+		slots.clear();
+		generations.clear();
+		livePositions.clear();
+		freeSlots.clear();
+		live.clear();
+	}
+};
+
+template <class T> const int TPGPool<T>::indexBits;
+template <class T> const uint32_t TPGPool<T>::indexMask;
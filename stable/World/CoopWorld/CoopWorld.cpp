@@ -59,14 +59,10 @@ shared_ptr<ParameterLink<bool>> CoopWorld::payForRepacementPL = Parameters::regi
 	"\nif replaceOnDeath is true, the offspring will start with an energy of reproCost - parent energy"
 	"\nif replaceOnDeath is false, the reprocost will be deducted from the parent, if the parent can not cover the cost, the offspring will start with reproCost - parent energy");
 
-// return Average value from a vector of double
-double vectorAve(vector<double> vect) {
-	double ave = 0;
-	for (auto val : vect) {
-		ave += val;
-	}
-	return(ave / (double)vect.size());
-}
+shared_ptr<ParameterLink<int>> CoopWorld::evaluationThreadsPL = Parameters::register_parameter("WORLD_COOP-evaluationThreads", 1,
+	"number of threads used to play subgroup games. brains must be safe to update at the same time (i.e. not use random numbers).\n"
+	"results are the same for any number of threads > 1. with more than 1 thread payoffs are added to scores one color class at a time,\n"
+	"so scores may differ from a 1 thread run in the last digits");
 
 CoopWorld::CoopWorld(shared_ptr<ParametersTable> _PT) :
 	AbstractWorld(_PT) {
@@ -154,6 +150,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 
 	bool replaceOnDeath = replaceOnDeathPL->get(PT);
 	bool payForRepacement = payForRepacementPL->get(PT);
+	int evaluationThreads = evaluationThreadsPL->get(PT);
 
 	// will track number of briths and deaths per update
 	int meritBirthCount = 0;
@@ -164,7 +161,8 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 
 	double numGamesPlayedPerMatch = subgroupSize * gamesPerSubgroup;
 
-	auto popSize = groups[groupName]->population.size();
+	auto & population = groups[groupName]->population;
+	auto popSize = population.size();
 	if (sqrt(popSize) != (int)sqrt(popSize)) {
 		cout << "  in CoopWorld :: population size (" << popSize << ") does not fit in a square.\n  exiting." << endl;
 		exit(1);
@@ -213,7 +211,20 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		exit(1);
 	}
 
-	CoopVector2d<shared_ptr<Agent>> worldGrid(worldX, worldY);
+	if (subgroupSize < 1 || subgroupSize > maxSubgroupSize) {
+		cout << "in CoopWorld :: subgroupSize must be between 1 and " << maxSubgroupSize << ". exiting." << endl;
+		exit(1);
+	}
+	// the subgroup of each focal agent does not change during a run
+	Subgroups subgroups;
+	subgroups.build(worldX, worldY, clansInX, clansInY, subgroupSize, playerOrder);
+
+	// agents are stored by grid cell, cell = x + y * worldX
+	Agents agents;
+	agents.resize(worldX * worldY);
+	auto cellOf = [worldX](const CoopPoint2d &loc) {
+		return (int)loc.x + (int)loc.y * worldX;
+	};
 
 	// allLocations is created so that we can pull random locations from a list.
 	vector<CoopPoint2d> allLocations;
@@ -223,289 +234,316 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		}
 	}
 
-	// highRank will be used to track agent with highest rank
-	// the rank reasignment is preformed by starting at the
-	// high rank individual and moving by rank though all agents.
-	shared_ptr<Agent> highRank;
+	// rankOrder keeps the cells in rank order (lowest first). births and deaths move cells in
+	// rankOrder and agents.rank is set from it once all births and deaths are done.
+	CoopRankTree rankOrder(worldX * worldY);
 
-	// last agent is only used durring inital setup and is the last
-	// agent added to the world (durring setup only!); 
-	shared_ptr<Agent> lastAgent;
+	// relative rank in a subgroup is found by sorting the subgroup's ranks
+	CoopSortingNetwork subgroupSort(subgroupSize);
 
 	// IDCount (probably not needed!) is used to assign a unique ID to each
 	// agent (diffrent from Organism->ID).
 	int IDcount = 0;
 	// for each organism in the original population, create an agent for
 	// that org. assign a rank based on agentID and then place randomly in
-	// world. Also each agent has a junior and senior. for first agent
-	// (lowest rank) set junior to self. best set senior to self.
-	for(auto ORG : groups[groupName]->population){
-		auto newAgent = make_shared<Agent>();
-		newAgent->rank = IDcount + 1; // this could be a unique random generator 
-		newAgent->agentID = IDcount;  // this should = index in allAgents
-		newAgent->org = ORG;
-		newAgent->brain = ORG->brains[brainName];
+	// world. each agent is added to rankOrder above the agents before it.
+	for(auto ORG : population){
 		auto pick = Random::getIndex(allLocations.size());
 		auto thisLocation = allLocations[pick];
 		allLocations[pick] = allLocations.back();
 		allLocations.pop_back();
-		worldGrid(thisLocation) = newAgent;
-		if (IDcount == 0) { // first agent, lowest rank
-			newAgent->junior = newAgent;
-		}
-		else if (IDcount < popSize - 1) { // agent in the middle
-			newAgent->junior = lastAgent;
-			lastAgent->senior = newAgent;
-		}
-		else { // last agent, highest rank
-			highRank = newAgent;
-			newAgent->junior = lastAgent;
-			newAgent->senior = newAgent;
-			lastAgent->senior = newAgent;
-		}
-		lastAgent = newAgent;
+		int newAgent = cellOf(thisLocation);
+		agents.place(newAgent, IDcount, ORG, brainName);
+		agents.populationIndex[newAgent] = IDcount;
+		agents.rank[newAgent] = IDcount + 1; // this could be a unique random generator 
+		agents.colorRed[newAgent] = Random::getDouble(1.0);
+		agents.colorBlue[newAgent] = Random::getDouble(1.0);
+		agents.colorGreen[newAgent] = Random::getDouble(1.0);
+		rankOrder.addHighest(newAgent);
 		IDcount++;
 	}
 
-	// define some variables we will be using over and over...
-	int whichXClan;
-	int whichYClan;
-	int clanXmin, clanYmin, clanXmax, clanYmax;
-
-	int numGroupHunt = 0;
-	int numSoloHunt = 0;
-	int numNoAction = 0;
-	int inputCount;
+	// with threads, the game payoffs of the subgroups of one color class, indexed by
+	// (position in class * gamesPerSubgroup + play) * subgroupSize + member. payoffs are added to
+	// the scores after the class is played, in class order, so the result does not depend on the
+	// number of threads. without threads payoffs are added to the scores as games are played.
+	vector<double> payoffs;
+	if (evaluationThreads > 1 && !debug) {
+		size_t largestClass = 0;
+		for (auto const & colorClass : subgroups.colorClasses) {
+			largestClass = max(largestClass, colorClass.size());
+		}
+		payoffs.resize(largestClass * gamesPerSubgroup * subgroupSize);
+	}
+	// group hunt thresholds of each game in an evaluation pass (if groupHuntSucceedThreashold is a range)
+	vector<int> huntThresholds(popSize * gamesPerSubgroup);
+
+	// play the games of the subgroup of focal cell i. when evaluationThreads > 1 this is run on
+	// several threads at once for focal cells whose subgroups do not share agents, and payoffs
+	// are written to subgroupPayoffs (by play and member) instead of being added to the scores.
+	auto playSubgroup = [&](int i, double *subgroupPayoffs) {
+		// iterate over agents in world - making each focal agent in turn
+		CoopPoint2d focalLoc = CoopPoint2d(i%worldX, (int)(i / worldX));
+		auto subgroup = subgroups.of(i);
+		int numGroupHunt = 0;
+		int numSoloHunt = 0;
+		int numNoAction = 0;
+		int inputCount;
+		if (debug) {
+			cout << "world size = " << worldX << "," << worldY << "   agent at: " << focalLoc.x << "," << focalLoc.y << endl;
+			for (auto agent : subgroup) {
+				cout << "adding agent: " << agents.agentID[agent] << " at " << agent % worldX << "," << agent / worldX << endl;
+			}
+			cout << " ----- " << endl;
+		}
 
-	// while the archivist for this group says we are not done...
-	while (!groups[groupName]->archivist->finished_) {
-		for (int r = 0; r < evaluationsPerGeneration; r++) {
-			for (int i = 0; i < popSize; i++) {
-				// iterate over agents in world - making each focal agent in turn
-				CoopPoint2d focalLoc = CoopPoint2d(i%worldX, (int)(i / worldX));
-				// figure out with clan this agent is in.
-				whichXClan = focalLoc.x / clanSizeInX;
-				whichYClan = focalLoc.y / clanSizeInY;
-				clanXmin = whichXClan * clanSizeInX;
-				clanXmax = ((whichXClan+1) * clanSizeInX);
-				clanYmin = whichYClan * clanSizeInY;
-				clanYmax = ((whichYClan + 1) * clanSizeInY);
-				if (debug) {
-					cout << "world size = " << worldX << "," << worldY << "   agent at: ";
-					cout << focalLoc.x << "," << focalLoc.y << " clan: " << whichXClan << "," << whichYClan << "   xXyY: " << clanXmin << "," << clanXmax << "," << clanYmin << "," << clanYmax << endl;
-				}
+		// get subgroup local ranks for each agent (1 + the number of agents in the subgroup
+		// with a lower rank)
+		double groupRanks[maxSubgroupSize];
+		int groupMembers[maxSubgroupSize];
+		for (int member = 0; member < subgroupSize; member++) {
+			groupRanks[member] = agents.rank[subgroup[member]];
+			groupMembers[member] = subgroup[member];
+			agents.brain[subgroup[member]]->resetBrain();
+		}
+		subgroupSort.sort(groupRanks, groupMembers);
+		for (int place = 0; place < subgroupSize; place++) {
+			if (place > 0 && groupRanks[place] == groupRanks[place - 1]) { // same agent twice (clan narrower than the subgroup)
+				agents.relativeRank[groupMembers[place]] = agents.relativeRank[groupMembers[place - 1]];
+			}
+			else {
+				agents.relativeRank[groupMembers[place]] = place + 1;
+			}
+		}
 
-				// make subgroup
-				vector<shared_ptr<Agent>> subgroup;
-				// add groupSize agents to subgroup. these agents are pulled from the
-				// local area around the focal agent. each location must be checked to make
-				// sure that we do not run off the edge of the clan.
-				for (int playerIndex = 0; playerIndex < subgroupSize; playerIndex++) {
-					auto newLoc = focalLoc + playerOrder[playerIndex];
-					if (newLoc.x < clanXmin) {
-						newLoc.x = clanXmax + (newLoc.x - clanXmin);;
+		// play games
+		for (int plays = 0; plays < gamesPerSubgroup; plays++) {
+			// set inputs and update brains
+			for (auto agent : subgroup) {
+				auto brain = agents.brain[agent];
+				inputCount = 0; // used to keep track of which brain input we are setting
+				// set inputs 0 to (groupSize-1) to be relitive rank for this agent in this subgroup
+
+				if (detectRank) {
+					for (int i = subgroupSize; i > 1; i--) {
+						brain->setInput(inputCount++, i <= agents.relativeRank[agent]);
 					}
-					else if (newLoc.x >= clanXmax) {
-						newLoc.x = newLoc.x - (clanSizeInX);
+				}
+				// old way, setting relativeRank as int (as apposed to a list of bool)
+				//brain->setInput(0, agents.relativeRank[agent]);
+				if (plays == 0) {
+					// next input indicates that this is first play
+					brain->setInput(inputCount++, 1);
+					// inputs are 0 because there is no actions from the last play
+					if (detectGroupHunt) {
+						for (int i = subgroupSize; i > 1; i--) {
+							brain->setInput(inputCount++, 0);
+						}
 					}
-					if (newLoc.y < clanYmin) {
-						newLoc.y = clanYmax + (newLoc.y - clanYmin);
+					if (detectSoloHunt) {
+						for (int i = subgroupSize; i > 1; i--) {
+							brain->setInput(inputCount++, 0);
+						}
 					}
-					else if (newLoc.y >= clanYmax) {
-						newLoc.y = newLoc.y - (clanSizeInY);
+				}
+				else {
+					// next input indicates that this is NOT first play
+					brain->setInput(inputCount++, 0);
+					// set bits based on how many other agents chose GroupHunt.
+					if (detectGroupHunt) {
+						int howManyOthersGroupHunt = numGroupHunt - (agents.action[agent] == Actions::GroupHunt);
+						for (int i = subgroupSize; i > 1; i--) {
+							brain->setInput(inputCount++, i <= howManyOthersGroupHunt);
+						}
 					}
-					subgroup.push_back(worldGrid(newLoc));
-					if (debug) {
-						cout << "adding agent: " << worldGrid(newLoc) << " at " << newLoc.x << "," << newLoc.y << endl;
+					if (detectSoloHunt) {
+						int howManyOthersSoloHunt = numSoloHunt - (agents.action[agent] == Actions::SoloHunt);
+						for (int i = subgroupSize; i > 1; i--) {
+							brain->setInput(inputCount++, i <= howManyOthersSoloHunt);
+						}
 					}
 				}
-				if (debug) {
-					cout << " ----- " << endl;
-				}
-
-				// get subgroup local ranks for each agent
-				vector<double> groupRanks;
-				for (auto agent : subgroup) {
-					groupRanks.push_back(agent->rank);
-				}
-				sort(begin(groupRanks), end(groupRanks));
-				for (auto agent : subgroup) {
-					agent->brain->resetBrain();
-					agent->relativeRank = 1 + distance(begin(groupRanks), find(begin(groupRanks), end(groupRanks), agent->rank));
-				}
+				// call update on this brain
+				brain->update();
+			}
 
-				// play games
-				for (int plays = 0; plays < gamesPerSubgroup; plays++) {
-					// set inputs and update brains
-					for (auto agent : subgroup) {
-						inputCount = 0; // used to keep track of which brain input we are setting
-						// set inputs 0 to (groupSize-1) to be relitive rank for this agent in this subgroup
+			// read outputs
 
-						if (detectRank) {
-							for (int i = subgroupSize; i > 1; i--) {
-								agent->brain->setInput(inputCount++, i <= agent->relativeRank);
-							}
-						}
-						// old way, setting relativeRank as int (as apposed to a list of bool)
-						//agent->brain->setInput(0, agent->relativeRank);
-						if (plays == 0) {
-							// next input indicates that this is first play
-							agent->brain->setInput(inputCount++, 1);
-							// inputs are 0 because there is no actions from the last play
-							if (detectGroupHunt) {
-								for (int i = subgroupSize; i > 1; i--) {
-									agent->brain->setInput(inputCount++, 0);
-								}
-							}
-							if (detectSoloHunt) {
-								for (int i = subgroupSize; i > 1; i--) {
-									agent->brain->setInput(inputCount++, 0);
-								}
-							}
-						}
-						else {
-							// next input indicates that this is NOT first play
-							agent->brain->setInput(inputCount++, 0);
-							// set bits based on how many other agents chose GroupHunt.
-							if (detectGroupHunt) {
-								int howManyOthersGroupHunt = numGroupHunt - (agent->action == Actions::GroupHunt);
-								for (int i = subgroupSize; i > 1; i--) {
-									agent->brain->setInput(inputCount++, i <= howManyOthersGroupHunt);
-								}
-							}
-							if (detectSoloHunt) {
-								int howManyOthersSoloHunt = numSoloHunt - (agent->action == Actions::SoloHunt);
-								for (int i = subgroupSize; i > 1; i--) {
-									agent->brain->setInput(inputCount++, i <= howManyOthersSoloHunt);
-								}
-							}
-						}
-						// call update on this brain
-						agent->brain->update();
-					}
 
-					// read outputs
+			numGroupHunt = 0;
+			numSoloHunt = 0;
+			numNoAction = 0;
+			double totalRealRankOfGroupHunters = 0;
+			double totalRelativeRankOfGroupHunters = 0;
+			double totalRealRankOfActiveHunters = 0;
+			double totalRelativeRankOfActiveHunters = 0;
 
+			// for each agent in subgroup, collect action value, convert to action and update states
+			for (auto agent : subgroup) {
+				int outputValue = 0;
+				
+				for (int outputCount = 0; outputCount < outputBits; outputCount++){
+					outputValue += (Bit(agents.brain[agent]->readOutput(outputCount)) * pow(2, outputCount));
+				}
+				if (outputBehaviors[outputValue]==Actions::GroupHunt) {
+					agents.action[agent] = Actions::GroupHunt;
+					agents.actionCounts[agent][(int)Actions::GroupHunt]++;
+					totalRealRankOfGroupHunters += agents.rank[agent];
+					totalRelativeRankOfGroupHunters += agents.relativeRank[agent];
+					totalRealRankOfActiveHunters += agents.rank[agent];
+					totalRelativeRankOfActiveHunters += agents.relativeRank[agent];
+					numGroupHunt++;
+				}
+				else if (outputBehaviors[outputValue] == Actions::SoloHunt) {
+					agents.action[agent] = Actions::SoloHunt;
+					agents.actionCounts[agent][(int)Actions::SoloHunt]++;
+					totalRealRankOfActiveHunters += agents.rank[agent];
+					totalRelativeRankOfActiveHunters += agents.relativeRank[agent];
+					numSoloHunt++;
+				}
+				else {
+					agents.action[agent] = Actions::No;
+					agents.actionCounts[agent][(int)Actions::No]++;
+					numNoAction++;
+				}
 
-					numGroupHunt = 0;
-					numSoloHunt = 0;
-					numNoAction = 0;
-					double totalRealRankOfGroupHunters = 0;
-					double totalRelativeRankOfGroupHunters = 0;
-					double totalRealRankOfActiveHunters = 0;
-					double totalRelativeRankOfActiveHunters = 0;
+			}
 
-					// for each agent in subgroup, collect action value, convert to action and update states
-					for (auto agent : subgroup) {
-						int outputValue = 0;
-						
-						for (int outputCount = 0; outputCount < outputBits; outputCount++){
-							outputValue += (Bit(agent->brain->readOutput(outputCount)) * pow(2, outputCount));
-						}
-						if (outputBehaviors[outputValue]==Actions::GroupHunt) {
-							agent->action = Actions::GroupHunt;
-							agent->actionCounts[Actions::GroupHunt]++;
-							totalRealRankOfGroupHunters += agent->rank;
-							totalRelativeRankOfGroupHunters += agent->relativeRank;
-							totalRealRankOfActiveHunters += agent->rank;
-							totalRelativeRankOfActiveHunters += agent->relativeRank;
-							numGroupHunt++;
-						}
-						else if (outputBehaviors[outputValue] == Actions::SoloHunt) {
-							agent->action = Actions::SoloHunt;
-							agent->actionCounts[Actions::SoloHunt]++;
-							totalRealRankOfActiveHunters += agent->rank;
-							totalRelativeRankOfActiveHunters += agent->relativeRank;
-							numSoloHunt++;
+			// did group hunt succeed?
+			bool successfulHunt = false;
+			if (groupHuntSucceedThreashold.size() == 1) { // if groupHuntSucceedThreashold is a single value
+				successfulHunt = numGroupHunt >= groupHuntSucceedThreashold[0];
+			}
+			else { // if groupHuntSucceedThreashold is a single value (probablistic success)
+				successfulHunt = numGroupHunt >= huntThresholds[i * gamesPerSubgroup + plays];
+			}
+			// calculate groupHuntPayoff
+			double groupHuntTotalPayoff = groupHuntPayoff * numGroupHunt * successfulHunt; // if none group hunt, there is no payoff
+
+			// calculate shares for group hunt
+			double realRankShare = groupHuntTotalPayoff / totalRealRankOfGroupHunters;
+			double relativeRankShare = groupHuntTotalPayoff / totalRelativeRankOfGroupHunters;
+			double publicGoodsRealRankShare = groupHuntTotalPayoff / totalRealRankOfActiveHunters;
+			double publicGoodsRelativeRankShare = groupHuntTotalPayoff / totalRelativeRankOfActiveHunters;
+
+			// for each agent, work out payoff based on action
+			for (int member = 0; member < subgroupSize; member++) {
+				int agent = subgroup[member];
+				double payoff;
+				if (agents.action[agent] == Actions::SoloHunt) {
+					agents.resultCounts[agent][(int)Results::SoloHuntSuccess]++;
+					agents.result[agent] = Results::SoloHuntSuccess;
+					if (publicGoods) {
+						if (useRealRankForGroupHuntScore) {
+							payoff = soloHuntPayoff +
+								((agents.rank[agent] * publicGoodsRealRankShare) * rankInfluenceOnGroupHuntScore) +
+								((groupHuntTotalPayoff/(numGroupHunt+numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
 						}
 						else {
-							agent->action = Actions::No;
-							agent->actionCounts[Actions::No]++;
-							numNoAction++;
+							payoff = soloHuntPayoff + 
+								((agents.relativeRank[agent] * publicGoodsRelativeRankShare) * rankInfluenceOnGroupHuntScore) +
+								((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
 						}
-
-					}
-
-					// did group hunt succeed?
-					bool successfulHunt = false;
-					if (groupHuntSucceedThreashold.size() == 1) { // if groupHuntSucceedThreashold is a single value
-						successfulHunt = numGroupHunt >= groupHuntSucceedThreashold[0];
 					}
-					else { // if groupHuntSucceedThreashold is a single value (probablistic success)
-						successfulHunt = numGroupHunt >= Random::getInt(groupHuntSucceedThreashold[0], groupHuntSucceedThreashold[1]);
+					else {
+						payoff = soloHuntPayoff;
 					}
-					// calculate groupHuntPayoff
-					double groupHuntTotalPayoff = groupHuntPayoff * numGroupHunt * successfulHunt; // if none group hunt, there is no payoff
-
-					// calculate shares for group hunt
-					double realRankShare = groupHuntTotalPayoff / totalRealRankOfGroupHunters;
-					double relativeRankShare = groupHuntTotalPayoff / totalRelativeRankOfGroupHunters;
-					double publicGoodsRealRankShare = groupHuntTotalPayoff / totalRealRankOfActiveHunters;
-					double publicGoodsRelativeRankShare = groupHuntTotalPayoff / totalRelativeRankOfActiveHunters;
-
-					// for each agent, update score based on action
-					for (auto agent : subgroup) {
-						if (agent->action == Actions::SoloHunt) {
-							agent->resultCounts[Results::SoloHuntSuccess]++;
-							agent->result = Results::SoloHuntSuccess;
-							if (publicGoods) {
-								if (useRealRankForGroupHuntScore) {
-									agent->scores.push_back(soloHuntPayoff +
-										((agent->rank * publicGoodsRealRankShare) * rankInfluenceOnGroupHuntScore) +
-										((groupHuntTotalPayoff/(numGroupHunt+numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore)));
-								}
-								else {
-									agent->scores.push_back(soloHuntPayoff + 
-										((agent->relativeRank * publicGoodsRelativeRankShare) * rankInfluenceOnGroupHuntScore) +
-										((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore)));
-								}
+				}
+				else if (agents.action[agent] == Actions::GroupHunt) {
+					if (successfulHunt) {
+						agents.resultCounts[agent][(int)Results::GroupHuntSuccess]++;
+						agents.result[agent] = Results::GroupHuntSuccess;
+						if (publicGoods) {
+							if (useRealRankForGroupHuntScore) {
+								auto thisPayoff = ((agents.rank[agent] * publicGoodsRealRankShare) * rankInfluenceOnGroupHuntScore)
+									+ ((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
+								payoff = thisPayoff;
 							}
 							else {
-								agent->scores.push_back(soloHuntPayoff);
+								auto thisPayoff = ((agents.relativeRank[agent] * publicGoodsRelativeRankShare) * rankInfluenceOnGroupHuntScore)
+									+ ((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
+								payoff = thisPayoff;
 							}
-						}
-						else if (agent->action == Actions::GroupHunt) {
-							if (successfulHunt) {
-								agent->resultCounts[Results::GroupHuntSuccess]++;
-								agent->result = Results::GroupHuntSuccess;
-								if (publicGoods) {
-									if (useRealRankForGroupHuntScore) {
-										auto thisPayoff = ((agent->rank * publicGoodsRealRankShare) * rankInfluenceOnGroupHuntScore)
-											+ ((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
-										agent->scores.push_back(thisPayoff);
-									}
-									else {
-										auto thisPayoff = ((agent->relativeRank * publicGoodsRelativeRankShare) * rankInfluenceOnGroupHuntScore)
-											+ ((groupHuntTotalPayoff / (numGroupHunt + numSoloHunt)) * (1.0 - rankInfluenceOnGroupHuntScore));
-										agent->scores.push_back(thisPayoff);
-									}
-								} else { // not public goods
-									if (useRealRankForGroupHuntScore) {
-										auto thisPayoff = ((agent->rank * realRankShare) * rankInfluenceOnGroupHuntScore)
-											+ ((groupHuntPayoff) * (1.0 - rankInfluenceOnGroupHuntScore));
-										agent->scores.push_back(thisPayoff);
-									}
-									else {
-										auto thisPayoff = ((agent->relativeRank * relativeRankShare) * rankInfluenceOnGroupHuntScore)
-											+ ((groupHuntPayoff) * (1.0 - rankInfluenceOnGroupHuntScore));
-										agent->scores.push_back(thisPayoff);
-									}
-								}
+						} else { // not public goods
+							if (useRealRankForGroupHuntScore) {
+								auto thisPayoff = ((agents.rank[agent] * realRankShare) * rankInfluenceOnGroupHuntScore)
+									+ ((groupHuntPayoff) * (1.0 - rankInfluenceOnGroupHuntScore));
+								payoff = thisPayoff;
 							}
 							else {
-								agent->resultCounts[Results::GroupHuntFail]++;
-								agent->result = Results::GroupHuntFail;
-								agent->scores.push_back(groupHuntFailPayoff);
+								auto thisPayoff = ((agents.relativeRank[agent] * relativeRankShare) * rankInfluenceOnGroupHuntScore)
+									+ ((groupHuntPayoff) * (1.0 - rankInfluenceOnGroupHuntScore));
+								payoff = thisPayoff;
 							}
 						}
-						else { // no action
-							agent->resultCounts[Results::No]++;
-							agent->result = Results::No;
-							agent->scores.push_back(noActionPayoff);
+					}
+					else {
+						agents.resultCounts[agent][(int)Results::GroupHuntFail]++;
+						agents.result[agent] = Results::GroupHuntFail;
+						payoff = groupHuntFailPayoff;
+					}
+				}
+				else { // no action
+					agents.resultCounts[agent][(int)Results::No]++;
+					agents.result[agent] = Results::No;
+					payoff = noActionPayoff;
+				}
+				if (subgroupPayoffs == nullptr) {
+					agents.addScore(agent, payoff);
+				}
+				else {
+					subgroupPayoffs[plays * subgroupSize + member] = payoff;
+				}
+			} // END update agent score based on action
+		} // end subGroup game for-loop
+	};
+
+	// while the archivist for this group says we are not done...
+	while (!groups[groupName]->archivist->finished_) {
+		for (int r = 0; r < evaluationsPerGeneration; r++) {
+			// thresholds are drawn before the games (in the order the games are listed in) so games
+			// do not use the common random generator
+			if (groupHuntSucceedThreashold.size() > 1) {
+				for (auto & threshold : huntThresholds) {
+					threshold = Random::getInt(groupHuntSucceedThreashold[0], groupHuntSucceedThreashold[1]);
+				}
+			}
+			if (evaluationThreads > 1 && !debug) {
+				// subgroups in a color class do not share agents, so each class is split between the
+				// threads. brains must be safe to update at the same time.
+				for (auto const & colorClass : subgroups.colorClasses) {
+					int classSize = colorClass.size();
+					int threadCount = min(evaluationThreads, max(1, classSize / 16)); // small classes are not worth a thread each
+					auto playPart = [&](int t) {
+						for (int c = (t * classSize) / threadCount; c < ((t + 1) * classSize) / threadCount; c++) {
+							playSubgroup(colorClass[c], &payoffs[c * gamesPerSubgroup * subgroupSize]);
+						}
+					};
+					vector<thread> threads;
+					for (int t = 1; t < threadCount; t++) {
+						threads.push_back(thread(playPart, t));
+					}
+					playPart(0);
+					for (auto & t : threads) {
+						t.join();
+					}
+					// add the class's payoffs to the scores, by position in class, play and member
+					for (int c = 0; c < classSize; c++) {
+						auto subgroup = subgroups.of(colorClass[c]);
+						const double *subgroupPayoffs = &payoffs[c * gamesPerSubgroup * subgroupSize];
+						for (int plays = 0; plays < gamesPerSubgroup; plays++) {
+							for (int member = 0; member < subgroupSize; member++) {
+								agents.addScore(subgroup[member], subgroupPayoffs[plays * subgroupSize + member]);
+							}
 						}
-					} // END update agent score based on action
-				} // end subGroup game for-loop
-			} // end evaluations per generation for-loop 
+					}
+				}
+			}
+			else {
+				for (int i = 0; i < popSize; i++) {
+					playSubgroup(i, nullptr);
+				}
+			}
 		} // END of whole population evaluation (all agents have been focal agent evaluationsPerGeneration times
 
 		
@@ -518,12 +556,13 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		// fill in scoreFGrid
 		for (int x = 0; x < worldX; x++) {
 			for (int y = 0; y < worldY; y++) {
-				scoreGrid(x, y) = vectorAve(worldGrid(x, y)->scores);
-				if (worldGrid(x, y)->energy > reproCost) {
+				int cell = x + y * worldX;
+				scoreGrid(x, y) = agents.averageScore(cell);
+				if (agents.energy[cell] > reproCost) {
 					reproList.push_back(CoopPoint2d(x, y));
 				}
-				if ((Global::update - worldGrid(x, y)->org->timeOfBirth) > lifespan[0]) {
-					if ((Global::update - worldGrid(x, y)->org->timeOfBirth) > Random::getInt(lifespan[0], lifespan[1])) {
+				if ((Global::update - agents.org[cell]->timeOfBirth) > lifespan[0]) {
+					if ((Global::update - agents.org[cell]->timeOfBirth) > Random::getInt(lifespan[0], lifespan[1])) {
 						killList.push_back(CoopPoint2d(x, y));
 					}
 				}
@@ -535,27 +574,30 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		double aveScore = 0;
 		for (int x = 0; x < worldX; x++) {
 			for (int y = 0; y < worldY; y++) {
-				auto agent = worldGrid(x, y);
-				double agentAveScore = vectorAve(agent->scores);
+				int agent = x + y * worldX;
+				auto & dataMap = agents.org[agent]->dataMap;
+				double agentAveScore = agents.averageScore(agent);
 				aveScore += agentAveScore;
 				if (agentAveScore > maxScore) {
 					maxScore = agentAveScore;
 				}
-				agent->energy += agentAveScore;
-				agent->aveScore = agentAveScore;
-				agent->org->dataMap.append("score", agent->scores);
-				agent->org->dataMap.append("optimizeValue", agentAveScore);
-				agent->org->dataMap.append("actionGroupHunt", (double)agent->actionCounts[Actions::GroupHunt] / numGamesPlayedPerMatch);
-				agent->org->dataMap.append("actionSoloHunt", (double)agent->actionCounts[Actions::SoloHunt] / numGamesPlayedPerMatch);
-				agent->org->dataMap.append("actionNo", (double)agent->actionCounts[Actions::No] / numGamesPlayedPerMatch);
-
-				agent->org->dataMap.append("resultGroupHuntSuccess", (double)agent->resultCounts[Results::GroupHuntSuccess] / numGamesPlayedPerMatch);
-				agent->org->dataMap.append("resultGroupHuntFail", (double)agent->resultCounts[Results::GroupHuntFail] / numGamesPlayedPerMatch);
-				agent->org->dataMap.append("resultSoloHuntSuccess", (double)agent->resultCounts[Results::SoloHuntSuccess] / numGamesPlayedPerMatch);
-				agent->org->dataMap.append("resultNo", (double)agent->resultCounts[Results::No] / numGamesPlayedPerMatch);
-
-				agent->org->dataMap.append("rank", agent->rank);
-				agent->org->dataMap.append("offspringCount", agent->offspringCount);
+				agents.energy[agent] += agentAveScore;
+				agents.aveScore[agent] = agentAveScore;
+				dataMap.append("score", agentAveScore);
+				dataMap.append("optimizeValue", agentAveScore);
+				auto const & actionCounts = agents.actionCounts[agent];
+				dataMap.append("actionGroupHunt", (double)actionCounts[(int)Actions::GroupHunt] / numGamesPlayedPerMatch);
+				dataMap.append("actionSoloHunt", (double)actionCounts[(int)Actions::SoloHunt] / numGamesPlayedPerMatch);
+				dataMap.append("actionNo", (double)actionCounts[(int)Actions::No] / numGamesPlayedPerMatch);
+
+				auto const & resultCounts = agents.resultCounts[agent];
+				dataMap.append("resultGroupHuntSuccess", (double)resultCounts[(int)Results::GroupHuntSuccess] / numGamesPlayedPerMatch);
+				dataMap.append("resultGroupHuntFail", (double)resultCounts[(int)Results::GroupHuntFail] / numGamesPlayedPerMatch);
+				dataMap.append("resultSoloHuntSuccess", (double)resultCounts[(int)Results::SoloHuntSuccess] / numGamesPlayedPerMatch);
+				dataMap.append("resultNo", (double)resultCounts[(int)Results::No] / numGamesPlayedPerMatch);
+
+				dataMap.append("rank", agents.rank[agent]);
+				dataMap.append("offspringCount", agents.offspringCount[agent]);
 			}
 		}
 		aveScore /= popSize;
@@ -566,7 +608,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string(worldGrid(x, y)->aveScore);
+					visualizeData += to_string(agents.aveScore[x + y * worldX]);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -579,7 +621,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string(worldGrid(x, y)->colorRed) + ":" + to_string(worldGrid(x, y)->colorGreen) + ":" + to_string(worldGrid(x, y)->colorBlue);
+					visualizeData += to_string(agents.colorRed[x + y * worldX]) + ":" + to_string(agents.colorGreen[x + y * worldX]) + ":" + to_string(agents.colorBlue[x + y * worldX]);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -592,7 +634,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string(worldGrid(x, y)->rank);
+					visualizeData += to_string(agents.rank[x + y * worldX]);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -605,7 +647,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string(worldGrid(x, y)->offspringCount);
+					visualizeData += to_string(agents.offspringCount[x + y * worldX]);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -618,7 +660,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string((int)worldGrid(x, y)->actionCounts[Actions::GroupHunt]) + ":" + to_string((int)worldGrid(x, y)->actionCounts[Actions::SoloHunt]) + ":" + to_string((int)worldGrid(x, y)->actionCounts[Actions::No]);
+					visualizeData += to_string(agents.actionCounts[x + y * worldX][(int)Actions::GroupHunt]) + ":" + to_string(agents.actionCounts[x + y * worldX][(int)Actions::SoloHunt]) + ":" + to_string(agents.actionCounts[x + y * worldX][(int)Actions::No]);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -631,7 +673,7 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 			visualizeData += to_string(worldX) + "," + to_string(worldY) + "\n";
 			for (int y = 0; y < worldY; y++) {
 				for (int x = 0; x < worldX; x++) {
-					visualizeData += to_string(Global::update - worldGrid(x, y)->org->timeOfBirth);
+					visualizeData += to_string(Global::update - agents.org[x + y * worldX]->timeOfBirth);
 					if (x % worldX == worldX - 1) {
 						visualizeData += "\n";
 					}
@@ -665,69 +707,31 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		while (reproList.size() > 0) {
 			auto pick = Random::getIndex(reproList.size());
 			auto thisLoc = reproList[pick];
-			auto thisAgent = worldGrid(thisLoc);
+			int thisAgent = cellOf(thisLoc);
 			reproList[pick] = reproList.back();
 			reproList.pop_back();
-			if (thisAgent->energy > reproCost) { // if this agent was not replaced by repro
-				thisAgent->energy -= reproCost;
-				thisAgent->offspringCount++;
+			if (agents.energy[thisAgent] > reproCost) { // if this agent was not replaced by repro
+				agents.energy[thisAgent] -= reproCost;
+				agents.offspringCount[thisAgent]++;
 				// select target cell (based on score)
 				auto offspringCell = scoreGrid.pickInArea(thisLoc, reproDistance,1); // method 1 is proportional pick
-				auto offspringWillReplace = worldGrid(offspringCell); // the agent to be replaced by offspring
-				auto newOrg = thisAgent->org->makeMutatedOffspringFrom(thisAgent->org);
-
-				auto newAgent = make_shared<Agent>();
-				newAgent->agentID = IDcount++;  // this should = index in allAgents
-				newAgent->org = newOrg;
-				newAgent->brain = newOrg->brains[brainName];
-				newAgent->colorRed = min(1.0, max(0.0, thisAgent->colorRed + Random::getDouble(-.025, .025)));
-				newAgent->colorGreen = min(1.0, max(0.0, thisAgent->colorGreen + Random::getDouble(-.025, .025)));
-				newAgent->colorBlue = min(1.0, max(0.0, thisAgent->colorBlue + Random::getDouble(-.025, .025)));
-				newAgent->action = Actions::undefined;
-
-				auto popIndex = distance(begin(groups[groupName]->population), find(begin(groups[groupName]->population), end(groups[groupName]->population), offspringWillReplace->org));
-				groups[groupName]->population[popIndex] = newOrg;
-
-				worldGrid(offspringCell) = newAgent;
-
-				//cout << endl << thisAgent->senior->rank << " : repaced agent senior rank" << endl;
-				//cout << thisAgent->rank << " : repaced agent rank (" << thisAgent->agentID << "," << thisAgent->org->ID << ")" << endl;
-				//cout << thisAgent->junior->rank << " : repaced agent junior rank" << endl << endl;
-				//cout << "   with: " << newAgent->agentID << "," << newAgent->org->ID << endl;
-				//cout << "   was: " << offspringWillReplace->agentID << "," << offspringWillReplace->org->ID << endl;
-
-				// put newAgent in after of thisAgent in rank
-				if (thisAgent->junior == thisAgent) { // parent is low rank
-					newAgent->junior = newAgent;
-					newAgent->senior = thisAgent;
-					thisAgent->junior = newAgent;
-				}
-				else {
-					newAgent->junior = thisAgent->junior;
-					newAgent->senior = thisAgent;
-					thisAgent->junior->senior = newAgent;
-					thisAgent->junior = newAgent;
-				}
+				int newAgent = cellOf(offspringCell); // the agent in this cell is replaced by the offspring
+				auto newOrg = agents.org[thisAgent]->makeMutatedOffspringFrom(agents.org[thisAgent]);
 
-				// remove offspringWillReplace from rank
-				if (offspringWillReplace->junior == offspringWillReplace) { // is low rank
-					offspringWillReplace->senior->junior = offspringWillReplace->senior;
-					offspringWillReplace->senior = nullptr;
-					offspringWillReplace->junior = nullptr;
-				}
-				else if (offspringWillReplace->senior == offspringWillReplace) { // is hi rank
-					highRank = offspringWillReplace->junior;
-					offspringWillReplace->junior->senior = offspringWillReplace->junior;
-					offspringWillReplace->senior = nullptr;
-					offspringWillReplace->junior = nullptr;
-				}
-				else {
-					offspringWillReplace->senior->junior = offspringWillReplace->junior;
-					offspringWillReplace->junior->senior = offspringWillReplace->senior;
-					offspringWillReplace->senior = nullptr;
-					offspringWillReplace->junior = nullptr;
+				population[agents.populationIndex[newAgent]] = newOrg;
+				agents.org[newAgent]->kill();
+
+				// remove the replaced agent from rank and put newAgent in after of thisAgent
+				// (if the offspring replaces thisAgent it takes its place in rank)
+				if (newAgent != thisAgent) {
+					rankOrder.remove(newAgent);
+					rankOrder.addBelow(newAgent, thisAgent);
 				}
-				offspringWillReplace->org->kill();
+
+				agents.place(newAgent, IDcount++, newOrg, brainName);
+				agents.colorRed[newAgent] = min(1.0, max(0.0, agents.colorRed[thisAgent] + Random::getDouble(-.025, .025)));
+				agents.colorGreen[newAgent] = min(1.0, max(0.0, agents.colorGreen[thisAgent] + Random::getDouble(-.025, .025)));
+				agents.colorBlue[newAgent] = min(1.0, max(0.0, agents.colorBlue[thisAgent] + Random::getDouble(-.025, .025)));
 				meritBirthCount += 1;
 			}
 		}
@@ -736,128 +740,52 @@ void CoopWorld::evaluate(map<string, shared_ptr<Group>>& groups, int analyze, in
 		// replace agent at each location in killList if new org was not born there this update.
 		// new agent is mutated copy, with same rank and color.
 		for (auto loc : killList) {
-			if (worldGrid(loc)->org->timeOfBirth != Global::update) { // if this org was not just born
-				auto thisAgent = worldGrid(loc);
-				auto newParent = thisAgent;
-
-				auto newAgent = make_shared<Agent>();
-				newAgent->agentID = IDcount++;  // this should = index in allAgents
+			int thisAgent = cellOf(loc);
+			if (agents.org[thisAgent]->timeOfBirth != Global::update) { // if this org was not just born
+				int newParent = thisAgent;
+				shared_ptr<Organism> newOrg;
+				double newEnergy = 0;
 
 				if (replaceOnDeath) {
-					auto newOrg = thisAgent->org->makeMutatedOffspringFrom(thisAgent->org);
-					newAgent->org = newOrg;
+					newOrg = agents.org[thisAgent]->makeMutatedOffspringFrom(agents.org[thisAgent]);
 					if (payForRepacement) {
-						newAgent->energy = -1 * reproCost;
+						newEnergy = -1 * reproCost;
 					}
 				} else {
 					auto parentCell = scoreGrid.pickInArea(loc, reproDistance, 3, false); // method 3 (random), pickLeast = false (pick max)
-					newParent = worldGrid(parentCell); // the agent to be replaced by offspring
-					auto newOrg = newParent->org->makeMutatedOffspringFrom(newParent->org);
-					newAgent->org = newOrg;
+					newParent = cellOf(parentCell);
+					newOrg = agents.org[newParent]->makeMutatedOffspringFrom(agents.org[newParent]);
 					if (payForRepacement) {
-						if (newParent->energy < reproCost) {
-							newAgent->energy = newParent->energy - reproCost;
+						if (agents.energy[newParent] < reproCost) {
+							newEnergy = agents.energy[newParent] - reproCost;
 						}
-						newParent->energy = max(0.0,newParent->energy-reproCost);
+						agents.energy[newParent] = max(0.0, agents.energy[newParent] - reproCost);
 					}
 				}
 
+				population[agents.populationIndex[thisAgent]] = newOrg;
+				agents.org[thisAgent]->kill();
 
-				newAgent->brain = newAgent->org->brains[brainName];
-				newAgent->colorRed = thisAgent->colorRed;
-				newAgent->colorGreen = thisAgent->colorGreen;
-				newAgent->colorBlue = thisAgent->colorBlue;
-				newAgent->action = Actions::undefined;
-				worldGrid(loc) = newAgent;
-
-				//cout << endl << thisAgent->senior->rank << " : repaced agent senior rank" << endl;
-				//cout << thisAgent->rank << " : repaced agent rank (" << thisAgent->agentID << "," << thisAgent->org->ID << ")" << endl;
-				//cout << thisAgent->junior->rank << " : repaced agent junior rank" << endl << endl;
-				//cout << "   with: " << newAgent->agentID << "," << newAgent->org->ID << endl;
-				auto popIndex = distance(begin(groups[groupName]->population), find(begin(groups[groupName]->population), end(groups[groupName]->population), thisAgent->org));
-				groups[groupName]->population[popIndex] = newAgent->org;
-
-				if (replaceOnDeath) {
-					// put newAgent in place of thisAgent in rank
-					if (thisAgent->junior == thisAgent) { // low rank
-						newAgent->junior = newAgent;
-						newAgent->senior = thisAgent->senior;
-						thisAgent->senior->junior = newAgent;
-					}
-					else if (thisAgent->senior == thisAgent) { // high rank
-						newAgent->senior = newAgent;
-						newAgent->junior = thisAgent->junior;
-						thisAgent->junior->senior = newAgent;
-						highRank = newAgent;
-					}
-					else { // in the middle
-						thisAgent->junior->senior = newAgent;
-						thisAgent->senior->junior = newAgent;
-						newAgent->junior = thisAgent->junior;
-						newAgent->senior = thisAgent->senior;
-					}
-					thisAgent->senior = nullptr;
-					thisAgent->junior = nullptr;
+				// with replaceOnDeath the new agent takes the rank of thisAgent (its place in the
+				// rank links does not change), else it is put in after newParent
+				if (!replaceOnDeath && newParent != thisAgent) {
+					rankOrder.remove(thisAgent);
+					rankOrder.addBelow(thisAgent, newParent);
 				}
-				else {
-					// put newAgent in after newParent
-					if (newParent->junior == newParent) { // low rank
-						newAgent->junior = newAgent;
-						newAgent->senior = newParent;
-						newParent->junior = newAgent;
-					}
-					else if (newParent->senior == newParent) { // high rank
-						newAgent->senior = newParent;
-						newAgent->junior = newParent->junior;
-						newParent->junior->senior = newAgent;
-						newParent->junior = newAgent;
-					}
-					else { // in the middle
-						newParent->junior->senior = newAgent;
-						newAgent->junior = newParent->junior;
-						newParent->junior = newAgent;
-						newAgent->senior = newParent;
-					}
-					//Now cut out thisAgent
-					if (thisAgent->junior == thisAgent) { // low rank
-						thisAgent->senior->junior = thisAgent->senior;
-					}
-					else if (thisAgent->senior == thisAgent) { // high rank
-						thisAgent->junior->senior = thisAgent->junior;
-						highRank = thisAgent->junior;
-					}
-					else { // in the middle
-						thisAgent->junior->senior = thisAgent->senior;
-						thisAgent->senior->junior = thisAgent->junior;
-					}
-					thisAgent->senior = nullptr;
-					thisAgent->junior = nullptr;
-				}
-				thisAgent->org->kill();
+
+				agents.place(thisAgent, IDcount++, newOrg, brainName);
+				agents.energy[thisAgent] = newEnergy;
 				replacementBirthCount += 1;
 			}
 		}
 
 		cout << "          meritBirths: " << meritBirthCount << "   replacementBirths: " << replacementBirthCount << endl;
 
-		// update rank values for all agents starting from highRank.
-		int currentRank = popSize;
-		shared_ptr<Agent> currentAgent = highRank;
-		while (currentAgent->junior != currentAgent) {
-			//cout << currentRank << " " << currentAgent->agentID << " : ";
-			currentAgent->rank = currentRank--;
-			currentAgent->scores.clear();
-			currentAgent->actionCounts.clear();
-			currentAgent->resultCounts.clear();
-			currentAgent = currentAgent->junior;
-
+		// update rank values for all agents from rankOrder.
+		for (int cell = 0; cell < worldX * worldY; cell++) {
+			agents.rank[cell] = rankOrder.rankOf(cell);
+			agents.clearGames(cell);
 		}
-		// set rank on lowrank (not handled by while loop)
-		currentAgent->rank = currentRank;
-		currentAgent->scores.clear();
-		currentAgent->actionCounts.clear();
-		currentAgent->resultCounts.clear();
-		//cout << endl;
 
 		// if the archivistsays we are finished add an EOF to the end of the visualization file
 		if (groups[groupNamePL->get(PT)]->archivist->finished_) {
@@ -12,9 +12,13 @@
 
 #include "../AbstractWorld.h"
 
+#include <algorithm>
+#include <array>
 #include <stdlib.h>
 #include <thread>
 #include <vector>
+#include "Utilities/CoopRankTree.h"
+#include "Utilities/CoopSortingNetwork.h"
 #include "Utilities/CoopVectorNd.h"
 
 using namespace std;
@@ -67,6 +71,10 @@ public:
 	static shared_ptr<ParameterLink<bool>> replaceOnDeathPL;
 	static shared_ptr<ParameterLink<bool>> payForRepacementPL;
 
+	static shared_ptr<ParameterLink<int>> evaluationThreadsPL;
+
+	static const int maxSubgroupSize = 25; // number of offsets in playerOrder
+
 	enum class Actions {
 		GroupHunt=2,
 		SoloHunt=1,
@@ -81,27 +89,141 @@ public:
 		No
 	};
 
-	class Agent {
+	// all agents of the world, one array per field, indexed by grid cell (x + y * worldX).
+	// when an agent is replaced the new agent is written over the old one in its cell.
+	class Agents {
+	public:
+		vector<int> agentID;
+		vector<shared_ptr<Organism>> org;
+		vector<int> populationIndex; // where org is in the group's population, replacements take the same slot
+		vector<AbstractBrain*> brain; // owned by org
+		vector<double> scoreSum; // sum of payoffs of the games played since ranks were last updated
+		vector<int> gamesPlayed;
+		vector<double> aveScore;
+		vector<double> energy;
+		vector<int> offspringCount;
+		vector<double> rank;
+		vector<double> relativeRank;
+		vector<Actions> action;
+		vector<Results> result;
+		vector<array<int, 4>> actionCounts; // indexed by Actions
+		vector<array<int, 4>> resultCounts; // indexed by Results
+		vector<double> colorRed;
+		vector<double> colorGreen;
+		vector<double> colorBlue;
+
+		void resize(int cellCount) {
+			agentID.resize(cellCount);
+			org.resize(cellCount);
+			populationIndex.resize(cellCount);
+			brain.resize(cellCount);
+			scoreSum.resize(cellCount);
+			gamesPlayed.resize(cellCount);
+			aveScore.resize(cellCount);
+			energy.resize(cellCount);
+			offspringCount.resize(cellCount);
+			rank.resize(cellCount);
+			relativeRank.resize(cellCount);
+			action.resize(cellCount);
+			result.resize(cellCount);
+			actionCounts.resize(cellCount);
+			resultCounts.resize(cellCount);
+			colorRed.resize(cellCount);
+			colorGreen.resize(cellCount);
+			colorBlue.resize(cellCount);
+		}
+
+		// put a new agent with org in cell. colors, rank and populationIndex are not changed.
+		void place(int cell, int ID, shared_ptr<Organism> newOrg, const string &brainName) {
+			agentID[cell] = ID;
+			brain[cell] = newOrg->brains[brainName].get();
+			org[cell] = newOrg;
+			energy[cell] = 0;
+			offspringCount[cell] = 0;
+			action[cell] = Actions::undefined;
+			clearGames(cell);
+		}
+
+		// clear scores and counters (done after ranks are updated)
+		void clearGames(int cell) {
+			scoreSum[cell] = 0;
+			gamesPlayed[cell] = 0;
+			actionCounts[cell].fill(0);
+			resultCounts[cell].fill(0);
+		}
+
+		void addScore(int cell, double score) {
+			scoreSum[cell] += score;
+			gamesPlayed[cell]++;
+		}
+
+		double averageScore(int cell) const {
+			return scoreSum[cell] / (double)gamesPlayed[cell];
+		}
+	};
+
+	// the subgroup of every focal cell, built once per run. the subgroupSize cells that play with
+	// focal cell i are stored side by side at cells[i * subgroupSize] (the focal cell first).
+	// each cell is the focal cell moved by an offset from playerOrder and wrapped around the
+	// edges of the focal cell's clan. focal cells are also split into color classes, the
+	// subgroups of the focal cells in a class do not share any cells.
+	class Subgroups {
 	public:
-		int agentID;
-		vector<double> scores;
-		double aveScore = 0;
-		double energy = 0;
-		shared_ptr<Organism> org;
-		shared_ptr<AbstractBrain> brain;
-		int offspringCount = 0;
-		double rank;
-		double relativeRank;
-		Actions action;
-		Results result;
-		map<Actions, int> actionCounts;
-		map<Results, int> resultCounts;
-		double colorRed = Random::getDouble(1.0);
-		double colorBlue = Random::getDouble(1.0);
-		double colorGreen = Random::getDouble(1.0);
-		shared_ptr<Agent> senior;
-		shared_ptr<Agent> junior;
+		int subgroupSize = 0;
+		vector<int> cells;
+		vector<vector<int>> colorClasses; // focal cells of each class, in increasing order
+
+		// cells of one subgroup, usable in a range for
+		struct Members {
+			const int *first;
+			const int *last;
+			const int *begin() const { return first; }
+			const int *end() const { return last; }
+			int operator[](int member) const { return first[member]; }
+		};
 
+		void build(int worldX, int worldY, int clansInX, int clansInY, int _subgroupSize, const vector<CoopPoint2d> &playerOrder) {
+			subgroupSize = _subgroupSize;
+			int clanSizeInX = worldX / clansInX;
+			int clanSizeInY = worldY / clansInY;
+			cells.resize(worldX * worldY * subgroupSize);
+			for (int focal = 0; focal < worldX * worldY; focal++) {
+				int x = focal % worldX;
+				int y = focal / worldX;
+				int clanXmin = (x / clanSizeInX) * clanSizeInX;
+				int clanYmin = (y / clanSizeInY) * clanSizeInY;
+				for (int playerIndex = 0; playerIndex < subgroupSize; playerIndex++) {
+					// offsets are at most 2, clans may be smaller than that
+					int newX = clanXmin + ((((x - clanXmin + (int)playerOrder[playerIndex].x) % clanSizeInX) + clanSizeInX) % clanSizeInX);
+					int newY = clanYmin + ((((y - clanYmin + (int)playerOrder[playerIndex].y) % clanSizeInY) + clanSizeInY) % clanSizeInY);
+					cells[focal * subgroupSize + playerIndex] = newX + newY * worldX;
+				}
+			}
+			// greedy coloring, each focal cell goes in the first class none of its cells are used in
+			colorClasses.clear();
+			vector<vector<bool>> used; // used[class][cell]
+			for (int focal = 0; focal < worldX * worldY; focal++) {
+				auto members = of(focal);
+				int colorClass = 0;
+				while (colorClass < (int)colorClasses.size() &&
+					any_of(members.begin(), members.end(), [&](int cell) { return used[colorClass][cell]; })) {
+					colorClass++;
+				}
+				if (colorClass == (int)colorClasses.size()) {
+					colorClasses.emplace_back();
+					used.emplace_back(worldX * worldY, false);
+				}
+				colorClasses[colorClass].push_back(focal);
+				for (auto cell : members) {
+					used[colorClass][cell] = true;
+				}
+			}
+		}
+
+		Members of(int focal) const {
+			const int *first = cells.data() + focal * subgroupSize;
+			return { first, first + subgroupSize };
+		}
 	};
 
 	CoopWorld(shared_ptr<ParametersTable> _PT = nullptr);
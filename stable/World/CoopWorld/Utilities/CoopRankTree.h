@@ -0,0 +1,146 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+// CoopRankTree keeps items 0 to itemCount-1 in rank order (lowest rank first) in an implicit treap
+// (a balanced binary tree ordered by position, each node keeps the size of its subtree), so
+// adding an item below another item, removing an item and finding the rank of an item are all
+// O(log n). items are stored in arrays indexed by item, so nothing is allocated after the tree
+// is made. node priorities come from a hash of the item, so the tree does not use the common
+// random generator.
+// no error checking is provided, an item must be removed before it is added again.
+
+class CoopRankTree {
+	vector<int> left, right, parent, size;
+	vector<uint32_t> priority;
+	int root = -1;
+
+	inline int sizeOf(int node) const {
+		return node < 0 ? 0 : size[node];
+	}
+
+	inline void setParent(int node, int newParent) {
+		if (node >= 0) {
+			parent[node] = newParent;
+		}
+	}
+
+	inline void update(int node) {
+		size[node] = 1 + sizeOf(left[node]) + sizeOf(right[node]);
+	}
+
+	// join two trees, all items in a are below all items in b
+	int merge(int a, int b) {
+		if (a < 0) {
+			return b;
+		}
+		if (b < 0) {
+			return a;
+		}
+		if (priority[a] > priority[b]) {
+			right[a] = merge(right[a], b);
+			setParent(right[a], a);
+			update(a);
+			return a;
+		}
+		left[b] = merge(a, left[b]);
+		setParent(left[b], b);
+		update(b);
+		return b;
+	}
+
+	// split tree into the lowest count items (a) and the rest (b)
+	void split(int tree, int count, int &a, int &b) {
+		if (tree < 0) {
+			a = b = -1;
+			return;
+		}
+		if (sizeOf(left[tree]) < count) {
+			split(right[tree], count - sizeOf(left[tree]) - 1, right[tree], b);
+			setParent(right[tree], tree);
+			a = tree;
+		}
+		else {
+			split(left[tree], count, a, left[tree]);
+			setParent(left[tree], tree);
+			b = tree;
+		}
+		update(tree);
+	}
+
+	// put item in as a tree of its own between the lowest count items and the rest
+	void insertAt(int item, int count) {
+		left[item] = right[item] = -1;
+		size[item] = 1;
+		int a, b;
+		split(root, count, a, b);
+		root = merge(merge(a, item), b);
+		parent[root] = -1;
+	}
+
+public:
+	CoopRankTree() = default;
+
+	explicit CoopRankTree(int itemCount) {
+		left.assign(itemCount, -1);
+		right.assign(itemCount, -1);
+		parent.assign(itemCount, -1);
+		size.assign(itemCount, 0);
+		priority.resize(itemCount);
+		for (int item = 0; item < itemCount; item++) {
+			uint32_t h = (uint32_t)item * 2654435761u; // mix the bits of item
+			h ^= h >> 16;
+			h *= 0x85ebca6bu;
+			h ^= h >> 13;
+			priority[item] = h;
+		}
+	}
+
+	int count() const {
+		return sizeOf(root);
+	}
+
+	// add item as the highest ranked item
+	void addHighest(int item) {
+		insertAt(item, count());
+	}
+
+	// add item directly below above (above must be in the tree)
+	void addBelow(int item, int above) {
+		insertAt(item, rankOf(above) - 1);
+	}
+
+	void remove(int item) {
+		int a, b, c;
+		split(root, rankOf(item) - 1, a, b);
+		split(b, 1, b, c); // b is now item
+		root = merge(a, c);
+		setParent(root, -1);
+		parent[item] = -1;
+		size[item] = 0;
+	}
+
+	// rank of item, 1 (lowest) to count()
+	int rankOf(int item) const {
+		int rank = sizeOf(left[item]) + 1;
+		for (int node = item; parent[node] >= 0; node = parent[node]) {
+			if (right[parent[node]] == node) {
+				rank += sizeOf(left[parent[node]]) + 1;
+			}
+		}
+		return rank;
+	}
+};
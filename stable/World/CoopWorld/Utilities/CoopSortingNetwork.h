@@ -0,0 +1,63 @@
+//  MABE is a product of The Hintze Lab @ MSU
+//     for general research information:
+//         hintzelab.msu.edu
+//     for MABE documentation:
+//         github.com/Hintzelab/MABE/wiki
+//
+//  Copyright (c) 2015 Michigan State University. All rights reserved.
+//     to view the full license, visit:
+//         github.com/Hintzelab/MABE/wiki/License
+
+#pragma once
+
+#include <utility>
+#include <vector>
+
+using namespace std;
+
+// CoopSortingNetwork is a fixed list of compare-exchange steps that sorts width values (Batcher's
+// odd-even merge sort). the list is made once for a width, so sorting a few values does no
+// branching on the data (other than the swaps) and allocates nothing.
+// the network is made for the next power of 2 and steps that reach past width are dropped
+// (this is the same as sorting with +infinity in the unused places).
+
+class CoopSortingNetwork {
+	vector<pair<int, int>> steps; // compare-exchange (low place, high place)
+	int width = 0;
+
+public:
+	CoopSortingNetwork() = default;
+
+	explicit CoopSortingNetwork(int _width) : width(_width) {
+		int paddedWidth = 1;
+		while (paddedWidth < width) {
+			paddedWidth *= 2;
+		}
+		for (int p = 1; p < paddedWidth; p *= 2) {
+			for (int k = p; k >= 1; k /= 2) {
+				for (int j = k % p; j + k < paddedWidth; j += 2 * k) {
+					for (int i = 0; i < k && i + j + k < paddedWidth; i++) {
+						if ((i + j) / (p * 2) == (i + j + k) / (p * 2) && i + j + k < width) {
+							steps.push_back({ i + j, i + j + k });
+						}
+					}
+				}
+			}
+		}
+	}
+
+	int size() const {
+		return width;
+	}
+
+	// sort keys[0] to keys[width-1] (lowest first), values are moved with their keys
+	template <typename Key, typename Value>
+	void sort(Key *keys, Value *values) const {
+		for (auto const & step : steps) {
+			if (keys[step.second] < keys[step.first]) {
+				swap(keys[step.first], keys[step.second]);
+				swap(values[step.first], values[step.second]);
+			}
+		}
+	}
+};
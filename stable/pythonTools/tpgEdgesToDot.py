@@ -0,0 +1,58 @@
+#!/usr/bin/python
+
+# converts a TPG binary edge list (saved by TPGOptimizer with OPTIMIZER_TPG-graphFormat = edgeList)
+# to a graphviz .dot file.
+# usage: python tpgEdgesToDot.py All_NaP_1000.edges [All_NaP_1000.dot]
+
+import struct
+import sys
+
+MAGIC = 0x45475054  # "TPGE"
+VERSION = 3
+NODE_TO_PROGRAM, PROGRAM_TO_NODE, PROGRAM_TO_ATOMIC = 0, 1, 2
+record = struct.Struct('<Bqq')
+
+if len(sys.argv) < 2:
+    print('usage: python tpgEdgesToDot.py edgeListFile [dotFile]')
+    sys.exit(1)
+inName = sys.argv[1]
+outName = sys.argv[2] if len(sys.argv) > 2 else inName.rsplit('.', 1)[0] + '.dot'
+
+with open(inName, 'rb') as inFile, open(outName, 'w') as outFile:
+    magic, version = struct.unpack('<II', inFile.read(8))
+    if magic != MAGIC or version != VERSION:
+        print(inName + ' is not a TPG edge list (version ' + str(VERSION) + ')')
+        sys.exit(1)
+    # atomic actions are named by their bits (outputs|hidden), as TPGGraphWriter::writeDot does
+    atomicNames = {}
+    atomicCount, = struct.unpack('<I', inFile.read(4))
+    for i in range(atomicCount):
+        index, length = struct.unpack('<qI', inFile.read(12))
+        bits = inFile.read(length).decode('ascii')
+        atomicNames[index] = ('A' + bits.replace('|', 'h'), bits)
+    seen = set()
+    outFile.write('digraph graphname {\n')
+    while True:
+        data = inFile.read(record.size)
+        if len(data) < record.size:
+            break
+        edgeType, source, target = record.unpack(data)
+        if edgeType == NODE_TO_PROGRAM:
+            sourceName, targetName = 'N' + str(source), 'P' + str(target)
+            if sourceName not in seen:
+                seen.add(sourceName)
+                outFile.write(sourceName + ' [color=yellow,shape=ellipse,style=filled]\n')
+        else:
+            sourceName = 'P' + str(source)
+            if sourceName not in seen:
+                seen.add(sourceName)
+                outFile.write(sourceName + ' [color=springGreen,shape=ellipse,style=filled]\n')
+            if edgeType == PROGRAM_TO_NODE:
+                targetName = 'N' + str(target)
+            else:
+                targetName, bits = atomicNames[target]
+                if targetName not in seen:
+                    seen.add(targetName)
+                    outFile.write(targetName + ' [color=lightgrey,shape=component,style=filled,label="' + bits + '"]\n')
+        outFile.write('  ' + sourceName + ' -> ' + targetName + '\n')
+    outFile.write('}\n')